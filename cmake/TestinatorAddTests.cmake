@@ -0,0 +1,99 @@
+# Run after a test executable is built: lists its tests and writes a CTest
+# file with one test per listed test, or with BATCH_SIZE set, one test per
+# batch of (about) BATCH_SIZE tests, each batch being a shard of the run.
+# Tests that measure time are never batched: each runs alone (RUN_SERIAL).
+#
+# Expects TEST_EXECUTABLE, TEST_NAME_PREFIX, CTEST_FILE and optionally
+# BATCH_SIZE and TEST_HISTORY to be defined.
+
+set(list_args "--list-tests=json")
+if(TEST_HISTORY)
+  list(APPEND list_args "--history=${TEST_HISTORY}")
+endif()
+
+execute_process(
+  COMMAND "${TEST_EXECUTABLE}" ${list_args}
+  OUTPUT_VARIABLE output
+  RESULT_VARIABLE result
+  )
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR
+    "Error listing tests in ${TEST_EXECUTABLE} (exit code ${result}):\n${output}")
+endif()
+
+set(entry_regex "{\"suite\": \"([^\"]*)\", \"name\": \"([^\"]*)\", \"type\": \"([A-Z_]*)\", \"cost\": ([0-9]+)}")
+string(REGEX MATCHALL "${entry_regex}" entries "${output}")
+
+# A name the regex can't match (one with an escaped quote or backslash) would
+# otherwise silently go missing.
+string(REGEX MATCHALL "{\"suite\": " listed "${output}")
+list(LENGTH entries num_tests)
+list(LENGTH listed num_listed)
+if(NOT num_tests EQUAL num_listed)
+  message(FATAL_ERROR
+    "Could read only ${num_tests} of the ${num_listed} tests listed by "
+    "${TEST_EXECUTABLE}; test names may not contain '\"' or '\\'.")
+endif()
+
+set(contents "# Generated by TestinatorAddTests.cmake from ${TEST_EXECUTABLE}\n")
+
+# Adds a CTest test that runs the listed test entry alone.
+macro(add_listed_test entry)
+  string(REGEX REPLACE "${entry_regex}" "\\1" sname "${entry}")
+  string(REGEX REPLACE "${entry_regex}" "\\2" tname "${entry}")
+  string(REGEX REPLACE "${entry_regex}" "\\3" type "${entry}")
+  string(REGEX REPLACE "${entry_regex}" "\\4" cost "${entry}")
+  if(sname STREQUAL "")
+    set(test_name "${TEST_NAME_PREFIX}.${tname}")
+  else()
+    set(test_name "${TEST_NAME_PREFIX}.${sname}.${tname}")
+  endif()
+  # CTest starts the most costly tests first; costs are in microseconds.
+  math(EXPR cost "${cost} / 1000")
+  set(contents "${contents}add_test(\"${test_name}\" \"${TEST_EXECUTABLE}\" \"--testName=${tname}\" \"--suiteName=${sname}\")\n")
+  set(contents "${contents}set_tests_properties(\"${test_name}\" PROPERTIES TIMEOUT 30 COST ${cost})\n")
+  # Tests that measure time must not share the machine with others.
+  if(type STREQUAL "COMPLEXITY_PROPERTY" OR type STREQUAL "TIMED_TEST")
+    set(contents "${contents}set_tests_properties(\"${test_name}\" PROPERTIES RUN_SERIAL TRUE)\n")
+  endif()
+endmacro()
+
+if(BATCH_SIZE AND num_tests GREATER 0)
+  # Tests that measure time can't share a batch, since batches run alongside
+  # each other: they run alone, and the batches exclude them.
+  set(batched 0)
+  set(exclude "")
+  foreach(entry ${entries})
+    string(REGEX REPLACE "${entry_regex}" "\\3" type "${entry}")
+    if(type STREQUAL "COMPLEXITY_PROPERTY" OR type STREQUAL "TIMED_TEST")
+      add_listed_test("${entry}")
+      if(exclude STREQUAL "")
+        set(exclude "-")
+      else()
+        set(exclude "${exclude}:")
+      endif()
+      set(exclude "${exclude}${sname}.${tname}")
+    else()
+      math(EXPR batched "${batched} + 1")
+    endif()
+  endforeach()
+  set(filter "")
+  if(NOT exclude STREQUAL "")
+    set(filter " \"--filter=*${exclude}\"")
+  endif()
+
+  math(EXPR num_batches "(${batched} + ${BATCH_SIZE} - 1) / ${BATCH_SIZE}")
+  set(batch 0)
+  while(batch LESS num_batches)
+    set(test_name "${TEST_NAME_PREFIX}.batch${batch}")
+    set(contents "${contents}add_test(\"${test_name}\" \"${TEST_EXECUTABLE}\" \"--shard=${batch}/${num_batches}\"${filter})\n")
+    set(contents "${contents}set_tests_properties(\"${test_name}\" PROPERTIES TIMEOUT 300)\n")
+    math(EXPR batch "${batch} + 1")
+  endwhile()
+else()
+  foreach(entry ${entries})
+    add_listed_test("${entry}")
+  endforeach()
+endif()
+
+file(WRITE "${CTEST_FILE}" "${contents}")
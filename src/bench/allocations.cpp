@@ -0,0 +1,144 @@
+// Copyright (c) 2014-2016 Ben Deane
+// This code is distributed under the MIT license. See LICENSE for details.
+
+// Allocation benchmark: counts the heap allocations made generating property
+// arguments, first by generating a fresh value each time and then by
+// regenerating one value in place (see Arbitrary<T>::regenerate), and then
+// those made by whole property checks. Once regenerated arguments are big
+// enough, the checks of properties on vector<int> and string should not
+// allocate at all; the benchmark fails if they do.
+
+#include <testinator.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace
+{
+  atomic<size_t> s_allocations{0};
+}
+
+void* operator new(size_t n)
+{
+  ++s_allocations;
+  if (void* p = malloc(n == 0 ? 1 : n)) return p;
+  throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  free(p);
+}
+
+namespace
+{
+  const size_t SIZE = 50;
+
+  template <typename F>
+  size_t CountAllocations(F f)
+  {
+    size_t before = s_allocations.load();
+    f();
+    return s_allocations.load() - before;
+  }
+
+  template <typename T>
+  void CompareGeneration(const char* what, size_t numValues)
+  {
+    testinator::GenerationSize::Scope size(SIZE);
+    size_t generated = CountAllocations([&] () {
+        for (unsigned long seed = 0; seed < numValues; ++seed)
+        {
+          T t = testinator::Arbitrary<T>::generate(1, seed);
+        }
+      });
+    size_t regenerated = CountAllocations([&] () {
+        T t;
+        for (unsigned long seed = 0; seed < numValues; ++seed)
+        {
+          testinator::Regenerate(t, 1, seed);
+        }
+      });
+    cout << what << ": " << numValues << " values generated with "
+         << generated << " allocations, regenerated with " << regenerated << endl;
+  }
+
+  struct VectorSum
+  {
+    bool operator()(const vector<int>& v) const
+    {
+      long long sum = 0;
+      for (int i : v) sum += i;
+      return sum != 1;
+    }
+    unsigned long m_randomSeed = 1;
+  };
+
+  struct StringLength
+  {
+    bool operator()(const string& s) const { return s.size() <= SIZE; }
+    unsigned long m_randomSeed = 1;
+  };
+
+  struct VectorOfStrings
+  {
+    bool operator()(const vector<string>& v) const { return v.size() <= SIZE; }
+    unsigned long m_randomSeed = 1;
+  };
+
+  // The allocations made by numChecks more checks: those that grow the
+  // arguments happen as often in either run, so what's left is the steady
+  // state.
+  template <typename F>
+  size_t SteadyStateAllocations(const char* what, size_t numChecks)
+  {
+    testinator::Outputter op;
+    testinator::CheckParams params;
+    params.m_maxSize = SIZE;
+    auto run = [&] (size_t n) {
+      return CountAllocations([&] () {
+          testinator::Property p(F{});
+          p.check(n, &op, nullptr, params);
+        });
+    };
+    size_t once = run(numChecks);
+    size_t twice = run(2 * numChecks);
+    size_t steady = twice > once ? twice - once : 0;
+    cout << what << ": " << numChecks << " checks with " << once
+         << " allocations, " << 2 * numChecks << " with " << twice
+         << " (" << steady << " in the steady state)" << endl;
+    return steady;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  size_t numChecks = 10000;
+  if (argc > 1)
+  {
+    char* end;
+    numChecks = strtoul(argv[1], &end, 10);
+  }
+
+  CompareGeneration<vector<int>>("vector<int>", numChecks);
+  CompareGeneration<string>("string", numChecks);
+  CompareGeneration<vector<string>>("vector<string>", numChecks);
+  CompareGeneration<map<int, string>>("map<int, string>", numChecks);
+
+  bool ok = SteadyStateAllocations<VectorSum>("vector<int> property", numChecks) == 0;
+  ok = SteadyStateAllocations<StringLength>("string property", numChecks) == 0 && ok;
+  SteadyStateAllocations<VectorOfStrings>("vector<string> property", numChecks);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
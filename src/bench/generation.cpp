@@ -0,0 +1,79 @@
+// Copyright (c) 2014-2016 Ben Deane
+// This code is distributed under the MIT license. See LICENSE for details.
+
+// Generation benchmark: generates a large vector<int> with Arbitrary (which
+// fills it in bulk), and for comparison the same number of values one at a
+// time, first the way Arbitrary used to, by seeding a std::mt19937 for each
+// value, then with a SplitMix64 seeded for each value.
+
+#include <testinator.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+using namespace std;
+
+namespace
+{
+  template <typename F>
+  long long TimeMs(F f)
+  {
+    auto t1 = chrono::steady_clock::now();
+    f();
+    auto t2 = chrono::steady_clock::now();
+    return chrono::duration_cast<chrono::milliseconds>(t2 - t1).count();
+  }
+
+  void Report(const char* what, size_t n, long long ms)
+  {
+    cout << what << ": " << n << " ints in " << ms << "ms";
+    if (ms > 0) cout << " (" << static_cast<long long>(n) / ms << " ints/ms)";
+    cout << endl;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  size_t numValues = 1000000;
+  if (argc > 1)
+  {
+    char* end;
+    numValues = strtoul(argv[1], &end, 10);
+  }
+
+  vector<int> before;
+  auto beforeMs = TimeMs([&] () {
+      mt19937 gen;
+      uniform_int_distribution<int> dis(
+          numeric_limits<int>::min() + 1, numeric_limits<int>::max() - 1);
+      before.reserve(numValues);
+      for (unsigned long seed = 0; seed < numValues; ++seed)
+      {
+        gen.seed(seed);
+        before.push_back(dis(gen));
+      }
+    });
+  Report("Reseeded mt19937", numValues, beforeMs);
+
+  vector<int> perValue;
+  auto perValueMs = TimeMs([&] () {
+      testinator::SplitMix64 streams(0);
+      perValue.reserve(numValues);
+      for (size_t i = 0; i < numValues; ++i)
+      {
+        perValue.push_back(testinator::Arbitrary<int>::generate(numValues, streams.Split()));
+      }
+    });
+  Report("Per-value SplitMix64", numValues, perValueMs);
+
+  vector<int> after;
+  auto afterMs = TimeMs([&] () {
+      after = testinator::Arbitrary<vector<int>>::generate_n(numValues, 0);
+    });
+  Report("Arbitrary<vector<int>>", numValues, afterMs);
+
+  return before.size() == after.size() && perValue.size() == after.size() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
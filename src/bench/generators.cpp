@@ -0,0 +1,114 @@
+// Copyright (c) 2014-2016 Ben Deane
+// This code is distributed under the MIT license. See LICENSE for details.
+
+// Generator benchmark: generates values of a small struct with a generator
+// composed from the combinators in generator.h, and for comparison with a
+// hand-written Arbitrary that makes the same random choices. The two should
+// generate the same values at about the same rate (in an optimized build);
+// the benchmark fails if the values differ.
+
+#include <testinator.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+struct Point
+{
+  int x;
+  int y;
+};
+
+namespace
+{
+  // Three times in four, a point on the line x + y = 999 (x not a multiple
+  // of 3); otherwise the origin or (1,1).
+  auto Composed()
+  {
+    using namespace testinator;
+    auto onLine = gen::Map(
+        gen::Filter(gen::InRange(0, 999), [] (int i) { return i % 3 != 0; }),
+        [] (int i) { return Point{i, 999 - i}; });
+    return gen::Frequency(gen::Weighted(3, onLine),
+                          gen::Weighted(1, gen::ElementOf(Point{0, 0}, Point{1, 1})));
+  }
+
+  struct HandWritten
+  {
+    static Point generate(size_t generation, unsigned long int randomSeed)
+    {
+      using testinator::SplitMix64;
+      SplitMix64 r(randomSeed);
+      uint64_t c = generation == 0 ? 0 : r.Split() % 4;
+      unsigned long int seed = r.Split();
+      if (c >= 3)
+      {
+        uint64_t i = generation == 0 ? 0 : SplitMix64::Mix(seed) % 2;
+        return i == 0 ? Point{0, 0} : Point{1, 1};
+      }
+      SplitMix64 tries(seed);
+      int x = 0;
+      for (size_t i = 0; i < 100; ++i)
+      {
+        x = generation == 0 ? 0 : static_cast<int>(SplitMix64::Mix(tries.Split()) % 1000);
+        if (x % 3 != 0) break;
+      }
+      return Point{x, 999 - x};
+    }
+  };
+
+  template <typename F>
+  long long TimeMs(F f)
+  {
+    auto t1 = chrono::steady_clock::now();
+    f();
+    auto t2 = chrono::steady_clock::now();
+    return chrono::duration_cast<chrono::milliseconds>(t2 - t1).count();
+  }
+
+  void Report(const char* what, size_t n, long long ms)
+  {
+    cout << what << ": " << n << " values in " << ms << "ms";
+    if (ms > 0) cout << " (" << static_cast<long long>(n) / ms << " values/ms)";
+    cout << endl;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  size_t numValues = 1000000;
+  if (argc > 1)
+  {
+    char* end;
+    numValues = strtoul(argv[1], &end, 10);
+  }
+
+  vector<Point> composed(numValues);
+  auto composedMs = TimeMs([&] () {
+      auto g = Composed();
+      for (size_t i = 0; i < numValues; ++i)
+      {
+        composed[i] = g.generate(1, i);
+      }
+    });
+  Report("Composed generator", numValues, composedMs);
+
+  vector<Point> handWritten(numValues);
+  auto handWrittenMs = TimeMs([&] () {
+      for (size_t i = 0; i < numValues; ++i)
+      {
+        handWritten[i] = HandWritten::generate(1, i);
+      }
+    });
+  Report("Hand-written Arbitrary", numValues, handWrittenMs);
+
+  bool same = true;
+  for (size_t i = 0; i < numValues; ++i)
+  {
+    same = same && composed[i].x == handWritten[i].x && composed[i].y == handWritten[i].y;
+  }
+  if (!same) cout << "The generators made different values" << endl;
+  return same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,63 @@
+// Copyright (c) 2014-2016 Ben Deane
+// This code is distributed under the MIT license. See LICENSE for details.
+
+// Property benchmark: checks a passing property on strings many times, with
+// each thread count from 1 to the number of hardware threads, to show how
+// spreading the checks over threads scales.
+
+#include <testinator.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+using namespace std;
+
+namespace
+{
+  template <typename F>
+  long long TimeMs(F f)
+  {
+    auto t1 = chrono::steady_clock::now();
+    f();
+    auto t2 = chrono::steady_clock::now();
+    return chrono::duration_cast<chrono::milliseconds>(t2 - t1).count();
+  }
+
+  struct StringReverse
+  {
+    bool operator()(const string& s) const
+    {
+      string r(s);
+      reverse(r.begin(), r.end());
+      reverse(r.begin(), r.end());
+      return s == r;
+    }
+    unsigned long m_randomSeed = 1;
+  };
+}
+
+int main(int argc, char* argv[])
+{
+  size_t numChecks = 100000;
+  if (argc > 1)
+  {
+    char* end;
+    numChecks = strtoul(argv[1], &end, 10);
+  }
+
+  size_t maxThreads = max(1u, thread::hardware_concurrency());
+  testinator::Outputter op;
+  bool ok = true;
+  for (size_t numThreads = 1; numThreads <= maxThreads; ++numThreads)
+  {
+    testinator::Property p(StringReverse{});
+    testinator::CheckParams params;
+    params.m_numThreads = numThreads;
+    auto ms = TimeMs([&] () { ok = p.check(numChecks, &op, nullptr, params) && ok; });
+    cout << numChecks << " checks on " << numThreads << " threads in " << ms << "ms" << endl;
+  }
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,72 @@
+// Copyright (c) 2014-2016 Ben Deane
+// This code is distributed under the MIT license. See LICENSE for details.
+
+// Startup benchmark: registers a large number of tests, as a binary with
+// generated test matrices does during static initialization, then times the
+// first lookup (which builds the indexes), a filtered run and
+// unregistration.
+
+#include <testinator.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace
+{
+  template <typename F>
+  long long TimeMs(F f)
+  {
+    auto t1 = chrono::steady_clock::now();
+    f();
+    auto t2 = chrono::steady_clock::now();
+    return chrono::duration_cast<chrono::milliseconds>(t2 - t1).count();
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  size_t numTests = 1000000;
+  if (argc > 1)
+  {
+    char* end;
+    numTests = strtoul(argv[1], &end, 10);
+  }
+
+  vector<string> names;
+  names.reserve(numTests);
+  for (size_t i = 0; i < numTests; ++i)
+  {
+    names.push_back("Test" + to_string(i));
+  }
+
+  testinator::TestRegistry r;
+  {
+    deque<testinator::Test> tests;
+
+    auto registerMs = TimeMs([&] () {
+        for (size_t i = 0; i < numTests; ++i)
+        {
+          tests.emplace_back(r, names[i], "Suite" + to_string(i % 100));
+        }
+      });
+    cout << "Registered " << numTests << " tests in " << registerMs << "ms" << endl;
+
+    auto lookupMs = TimeMs([&] () { r.RunTest("NoSuchTest"); });
+    cout << "First lookup in " << lookupMs << "ms" << endl;
+
+    testinator::Results rs;
+    auto filterMs = TimeMs([&] () {
+        rs = r.RunFiltered(testinator::TestFilter("Test123*-Suite0.*"));
+      });
+    cout << "Ran " << rs.size() << " filtered tests in " << filterMs << "ms" << endl;
+
+    auto unregisterMs = TimeMs([&] () { tests.clear(); });
+    cout << "Unregistered " << numTests << " tests in " << unregisterMs << "ms" << endl;
+  }
+  return 0;
+}
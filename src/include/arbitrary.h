@@ -3,7 +3,14 @@
 
 #pragma once
 
+#include "choice.h"
+#include "rng.h"
+
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace testinator
@@ -35,10 +42,188 @@ namespace testinator
   template <typename T>
   struct Arbitrary<const T> : public Arbitrary<T> {};
 
+  //------------------------------------------------------------------------------
+  // An Arbitrary<T> may also supply
+  //
+  //   static void generate_batch(T* out, std::size_t count,
+  //                              std::size_t generation, unsigned long int randomSeed);
+  //
+  // which fills out[0..count) with values all at once. They come from the same
+  // distribution as generate(generation, ...)'s, but are not the same values
+  // for the seed, and are neither recorded nor replayed as choices (see
+  // ChoiceSequence). So it is only used by generate_n, which sizes the inputs
+  // of complexity properties, where choices don't apply; the arithmetic types
+  // supply it so that large containers of them are cheap to generate.
+  // GenerateBatch calls it if it exists, and otherwise calls generate for each
+  // value with its own seed.
+  template <typename T, typename = void>
+  struct has_generate_batch : public std::false_type {};
+
+  template <typename T>
+  struct has_generate_batch<
+    T, decltype(void(Arbitrary<T>::generate_batch(
+        std::declval<T*>(), std::size_t{}, std::size_t{}, 0ul)))>
+    : public std::true_type {};
+
+  template <typename T>
+  inline void GenerateBatch(T* out, std::size_t count,
+                            std::size_t generation, unsigned long int randomSeed,
+                            std::true_type)
+  {
+    Arbitrary<T>::generate_batch(out, count, generation, randomSeed);
+  }
+
+  template <typename T>
+  inline void GenerateBatch(T* out, std::size_t count,
+                            std::size_t generation, unsigned long int randomSeed,
+                            std::false_type)
+  {
+    SplitMix64 streams(randomSeed);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      out[i] = Arbitrary<T>::generate(generation, streams.Split());
+    }
+  }
+
+  template <typename T>
+  inline void GenerateBatch(T* out, std::size_t count,
+                            std::size_t generation, unsigned long int randomSeed)
+  {
+    GenerateBatch(out, count, generation, randomSeed, has_generate_batch<T>{});
+  }
+
+  //------------------------------------------------------------------------------
+  // An Arbitrary<T> may also supply
+  //
+  //   static void regenerate(T& t, std::size_t generation, unsigned long int randomSeed);
+  //
+  // which sets t to the value generate(generation, randomSeed) would return,
+  // reusing t's storage; the containers do, so that a property that keeps its
+  // arguments between checks stops allocating once they are big enough.
+  // Regenerate calls it if it exists, and otherwise assigns a generated value.
+  template <typename T, typename = void>
+  struct has_regenerate : public std::false_type {};
+
+  template <typename T>
+  struct has_regenerate<
+    T, decltype(void(Arbitrary<T>::regenerate(
+        std::declval<T&>(), std::size_t{}, 0ul)))>
+    : public std::true_type {};
+
+  template <typename T>
+  inline void Regenerate(T& t, std::size_t generation, unsigned long int randomSeed,
+                         std::true_type)
+  {
+    Arbitrary<T>::regenerate(t, generation, randomSeed);
+  }
+
+  template <typename T>
+  inline void Regenerate(T& t, std::size_t generation, unsigned long int randomSeed,
+                         std::false_type)
+  {
+    t = Arbitrary<T>::generate(generation, randomSeed);
+  }
+
+  template <typename T>
+  inline void Regenerate(T& t, std::size_t generation, unsigned long int randomSeed)
+  {
+    Regenerate(t, generation, randomSeed, has_regenerate<T>{});
+  }
+
+  //------------------------------------------------------------------------------
+  // How the container specializations make the empty container they generate
+  // into: by default, with a default-constructed allocator. A specialization
+  // can supply the allocator instead; those for pmr containers do (see
+  // arbitrary_pmr.h).
+  template <typename C, typename = void>
+  struct ContainerFactory
+  {
+    static C make() { return C(); }
+  };
+
+  template <typename C>
+  inline C NewContainer()
+  {
+    return ContainerFactory<C>::make();
+  }
+
+  //------------------------------------------------------------------------------
+  // The size of the containers generated on this thread. A property sets it
+  // for each check, ramping it up from 0 over the checks (see --maxSize), so
+  // that small cases are tried first and no case is bigger than the limit.
+  // While a size is set, a container has a random number of elements from 0 to
+  // the size; otherwise (when generate is called directly) it has
+  // N * (generation / 100 + 1).
+  class GenerationSize
+  {
+  public:
+    static const std::size_t UNSET = static_cast<std::size_t>(-1);
+
+    static std::size_t Current() { return CurrentRef(); }
+
+    // Sets the size on this thread while in scope.
+    class Scope
+    {
+    public:
+      Scope(std::size_t size) : m_previous(CurrentRef()) { CurrentRef() = size; }
+      ~Scope() { CurrentRef() = m_previous; }
+
+    private:
+      std::size_t m_previous;
+    };
+
+  private:
+    static std::size_t& CurrentRef()
+    {
+      thread_local std::size_t s_size = UNSET;
+      return s_size;
+    }
+  };
+
+  // The number of elements in a container generated with the given generation
+  // and seed. The count doesn't use up any of the seed's stream, so the
+  // elements are the same whatever the size.
+  inline std::size_t ContainerSize(std::size_t N, std::size_t generation,
+                                   unsigned long int randomSeed)
+  {
+    std::size_t size = GenerationSize::Current();
+    if (size == GenerationSize::UNSET) return N * ((generation / 100) + 1);
+    return static_cast<std::size_t>(
+        SplitMix64::Mix(~static_cast<uint64_t>(randomSeed)) % (size + 1));
+  }
+
+  //------------------------------------------------------------------------------
+  // Calls f() to make each of the n elements of a container. With a choice
+  // sequence active, each element is preceded by a choice of whether to go on,
+  // and the elements are followed by a choice to stop (unless the container
+  // is as big as the generation size allows). So shrinking can drop an element
+  // by deleting its choices, or drop the rest by zeroing one; and replaying
+  // other choices may make the container any size up to the generation size.
+  template <typename F>
+  inline void GenerateElements(std::size_t n, F f)
+  {
+    ChoiceSequence* c = ChoiceSequence::Active();
+    if (c == nullptr)
+    {
+      for (std::size_t i = 0; i < n; ++i) f();
+      return;
+    }
+
+    std::size_t size = GenerationSize::Current();
+    std::size_t cap = size == GenerationSize::UNSET ? n : std::max(n, size);
+    for (std::size_t i = 0; i < cap && c->Draw(i < n ? 1 : 0) != 0; ++i)
+    {
+      f();
+    }
+  }
+
 }
 
 #include "arbitrary_arithmetic.h"
 #include "arbitrary_associative_containers.h"
+#include "arbitrary_hash_keys.h"
+#include "arbitrary_pmr.h"
 #include "arbitrary_sequence_containers.h"
+#include "arbitrary_shapes.h"
 #include "arbitrary_string.h"
 #include "arbitrary_utility.h"
@@ -4,21 +4,128 @@
 #pragma once
 
 #include "arbitrary.h"
-#include "test.h"
+#include "choice.h"
+#include "rng.h"
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <limits>
 #include <random>
+#include <type_traits>
 
 namespace testinator
 {
 
   namespace detail
   {
+    // Maps random bits r to [lo, hi]. Small ranges use the high 32 bits
+    // (multiply and shift rather than divide); the slight bias doesn't matter
+    // for test data.
+    template <typename T>
+    inline T UniformInt(uint64_t r, T lo, T hi)
+    {
+      uint64_t ulo = static_cast<uint64_t>(lo);
+      uint64_t range = static_cast<uint64_t>(hi) - ulo + 1;
+      uint64_t u = range <= (uint64_t{1} << 32)
+        ? ((r >> 32) * range) >> 32
+        : r % range;
+      return static_cast<T>(ulo + u);
+    }
+
+    // Maps random bits r to [lo, hi).
+    template <typename T>
+    inline T UniformReal(uint64_t r, T lo, T hi)
+    {
+      double u = static_cast<double>(r >> 11) * (1.0 / 9007199254740992.0);
+      return lo + static_cast<T>(u) * (hi - lo);
+    }
+
+    // Values and choices (see ChoiceSequence) map to each other so that a
+    // choice of 0 gives 0 and smaller choices give values nearer 0: for signed
+    // integers 0, -1, 1, -2, 2, ...; for reals, the bits of the magnitude
+    // (via double) followed by the sign.
+    template <typename T>
+    inline uint64_t ToChoice(T v, std::true_type /*integral*/)
+    {
+      if (!std::is_signed<T>::value) return static_cast<uint64_t>(v);
+      int64_t i = static_cast<int64_t>(v);
+      return i < 0
+        ? (static_cast<uint64_t>(-(i + 1)) << 1) | 1
+        : static_cast<uint64_t>(i) << 1;
+    }
+
+    template <typename T>
+    inline T FromChoice(uint64_t c, std::true_type /*integral*/)
+    {
+      if (!std::is_signed<T>::value) return static_cast<T>(c);
+      int64_t i = static_cast<int64_t>(c >> 1);
+      return static_cast<T>((c & 1) != 0 ? -i - 1 : i);
+    }
+
+    template <typename T>
+    inline uint64_t ToChoice(T v, std::false_type /*integral*/)
+    {
+      double d = static_cast<double>(v);
+      uint64_t bits;
+      std::memcpy(&bits, &d, sizeof(bits));
+      return (bits << 1) | (bits >> 63);
+    }
+
+    template <typename T>
+    inline T FromChoice(uint64_t c, std::false_type /*integral*/)
+    {
+      uint64_t bits = (c >> 1) | (c << 63);
+      double d;
+      std::memcpy(&d, &bits, sizeof(d));
+      return static_cast<T>(d);
+    }
+
+    // Passes v through the active choice sequence, if any: recording gives
+    // back v, and replaying gives the value of the replayed choice.
+    template <typename T>
+    inline T Chosen(T v)
+    {
+      using integral = typename std::is_integral<T>::type;
+      ChoiceSequence* c = ChoiceSequence::Active();
+      return c != nullptr
+        ? FromChoice<T>(c->Draw(ToChoice(v, integral{})), integral{})
+        : v;
+    }
+
+    // Fills out[0..count) with convert(r) for random bits r from a
+    // Xoshiro256x4 seeded with randomSeed.
+    template <typename T, typename F>
+    inline void FillRandom(T* out, std::size_t count, unsigned long int randomSeed,
+                           F convert)
+    {
+      static const std::size_t STEPS = 64;
+      const std::size_t lanes = Xoshiro256x4::LANES;
+      uint64_t buf[STEPS * Xoshiro256x4::LANES];
+      Xoshiro256x4 gen(randomSeed);
+      while (count > 0)
+      {
+        std::size_t n = std::min(count, STEPS * lanes);
+        gen.Generate(buf, (n + lanes - 1) / lanes);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+          out[i] = convert(buf[i]);
+        }
+        out += n;
+        count -= n;
+      }
+    }
+
     template <typename T>
     struct Arbitrary_Arithmetic
     {
       static T generate(std::size_t generation, unsigned long int randomSeed)
+      {
+        return Chosen(generateValue(generation, randomSeed));
+      }
+
+      static T generateValue(std::size_t generation, unsigned long int randomSeed)
       {
         switch (generation)
         {
@@ -31,8 +138,7 @@ namespace testinator
 
           default:
           {
-            std::mt19937& gen = testinator::GetTestRegistry().RNG();
-            gen.seed(randomSeed);
+            SplitMix64 gen(randomSeed);
             std::uniform_int_distribution<T> dis(
                 std::numeric_limits<T>::min() + 1, std::numeric_limits<T>::max() - 1);
             return dis(gen);
@@ -45,6 +151,18 @@ namespace testinator
         return generate(n, randomSeed);
       }
 
+      static void generate_batch(T* out, std::size_t count,
+                                 std::size_t generation, unsigned long int randomSeed)
+      {
+        if (generation <= 2)
+          std::fill_n(out, count, generateValue(generation, randomSeed));
+        else
+          FillRandom(out, count, randomSeed, [] (uint64_t r) {
+              return UniformInt<T>(r, static_cast<T>(std::numeric_limits<T>::min() + 1),
+                                   static_cast<T>(std::numeric_limits<T>::max() - 1));
+            });
+      }
+
       static std::vector<T> shrink(const T&)
       {
         return std::vector<T>();
@@ -55,6 +173,11 @@ namespace testinator
     struct Arbitrary_Arithmetic_IntCast
     {
       static T generate(std::size_t generation, unsigned long int randomSeed)
+      {
+        return Chosen(generateValue(generation, randomSeed));
+      }
+
+      static T generateValue(std::size_t generation, unsigned long int randomSeed)
       {
         switch (generation)
         {
@@ -67,8 +190,7 @@ namespace testinator
 
           default:
           {
-            std::mt19937& gen = testinator::GetTestRegistry().RNG();
-            gen.seed(randomSeed);
+            SplitMix64 gen(randomSeed);
             std::uniform_int_distribution<int> dis(
                 std::numeric_limits<T>::min() + 1, std::numeric_limits<T>::max() - 1);
             return static_cast<T>(dis(gen));
@@ -81,6 +203,18 @@ namespace testinator
         return generate(n, randomSeed);
       }
 
+      static void generate_batch(T* out, std::size_t count,
+                                 std::size_t generation, unsigned long int randomSeed)
+      {
+        if (generation <= 2)
+          std::fill_n(out, count, generateValue(generation, randomSeed));
+        else
+          FillRandom(out, count, randomSeed, [] (uint64_t r) {
+              return UniformInt<T>(r, static_cast<T>(std::numeric_limits<T>::min() + 1),
+                                   static_cast<T>(std::numeric_limits<T>::max() - 1));
+            });
+      }
+
       static std::vector<T> shrink(const T&)
       {
         return std::vector<T>();
@@ -91,6 +225,11 @@ namespace testinator
     struct Arbitrary_Arithmetic_Real
     {
       static T generate(std::size_t generation, unsigned long int randomSeed)
+      {
+        return Chosen(generateValue(generation, randomSeed));
+      }
+
+      static T generateValue(std::size_t generation, unsigned long int randomSeed)
       {
         switch (generation)
         {
@@ -105,8 +244,7 @@ namespace testinator
 
           default:
           {
-            std::mt19937& gen = testinator::GetTestRegistry().RNG();
-            gen.seed(randomSeed);
+            SplitMix64 gen(randomSeed);
             std::uniform_real_distribution<T> dis(
                 std::numeric_limits<T>::min(), std::numeric_limits<T>::max());
             return dis(gen);
@@ -119,6 +257,18 @@ namespace testinator
         return generate(n, randomSeed);
       }
 
+      static void generate_batch(T* out, std::size_t count,
+                                 std::size_t generation, unsigned long int randomSeed)
+      {
+        if (generation <= 3)
+          std::fill_n(out, count, generateValue(generation, randomSeed));
+        else
+          FillRandom(out, count, randomSeed, [] (uint64_t r) {
+              return UniformReal<T>(r, std::numeric_limits<T>::min(),
+                                    std::numeric_limits<T>::max());
+            });
+      }
+
       static std::vector<T> shrink(const T&)
       {
         return std::vector<T>();
@@ -189,7 +339,10 @@ namespace testinator
   {
     static bool generate(std::size_t generation, unsigned long int)
     {
-      return (generation & 1) == 0;
+      bool b = (generation & 1) == 0;
+      if (ChoiceSequence* c = ChoiceSequence::Active())
+        return c->Draw(b ? 1 : 0) % 2 != 0;
+      return b;
     }
 
     static bool generate_n(std::size_t n, unsigned long int randomSeed)
@@ -211,10 +364,12 @@ namespace testinator
   {
     static char generate(std::size_t, unsigned long int randomSeed)
     {
-      std::mt19937& gen = testinator::GetTestRegistry().RNG();
-      gen.seed(randomSeed);
+      SplitMix64 gen(randomSeed);
       std::uniform_int_distribution<int> dis(32, 126);
-      return static_cast<char>(dis(gen));
+      char v = static_cast<char>(dis(gen));
+      if (ChoiceSequence* c = ChoiceSequence::Active())
+        return static_cast<char>(32 + c->Draw(static_cast<uint64_t>(v - 32)) % 95);
+      return v;
     }
 
     static char generate_n(std::size_t n, unsigned long int randomSeed)
@@ -222,6 +377,14 @@ namespace testinator
       return generate(n, randomSeed);
     }
 
+    static void generate_batch(char* out, std::size_t count,
+                               std::size_t, unsigned long int randomSeed)
+    {
+      detail::FillRandom(out, count, randomSeed, [] (uint64_t r) {
+          return detail::UniformInt<char>(r, 32, 126);
+        });
+    }
+
     static std::vector<char> shrink(const char&)
     {
       return std::vector<char>();
@@ -4,6 +4,8 @@
 #pragma once
 
 #include "arbitrary.h"
+#include "choice.h"
+#include "rng.h"
 
 #include <algorithm>
 #include <cstddef>
@@ -17,7 +19,7 @@
 namespace testinator
 {
 
-  namespace
+  namespace detail
   {
     template <typename C>
     struct Arbitrary_Assoc
@@ -27,21 +29,33 @@ namespace testinator
 
       static C generate(std::size_t generation, unsigned long int randomSeed)
       {
-        C v;
+        C v = NewContainer<C>();
         if (generation == 0) return v;
-        std::size_t n = N * ((generation / 100) + 1);
-        std::generate_n(
-            std::inserter(v, v.begin()), n,
-            [&] () { return Arbitrary<V>::generate(generation++, randomSeed++); });
+        std::size_t n = ContainerSize(N, generation, randomSeed);
+        SplitMix64 streams(randomSeed);
+        GenerateElements(
+            n, [&] () { v.insert(Arbitrary<V>::generate(generation++, streams.Split())); });
         return v;
       }
 
+      // Clearing keeps an unordered container's buckets; nodes are not reused.
+      static void regenerate(C& v, std::size_t generation, unsigned long int randomSeed)
+      {
+        v.clear();
+        if (generation == 0) return;
+        std::size_t n = ContainerSize(N, generation, randomSeed);
+        SplitMix64 streams(randomSeed);
+        GenerateElements(
+            n, [&] () { v.insert(Arbitrary<V>::generate(generation++, streams.Split())); });
+      }
+
       static C generate_n(std::size_t n, unsigned long int randomSeed)
       {
-        C v;
+        C v = NewContainer<C>();
+        SplitMix64 streams(randomSeed);
         std::generate_n(
             std::inserter(v, v.begin()), n,
-            [&] () { return Arbitrary<V>::generate_n(n, randomSeed++); });
+            [&] () { return Arbitrary<V>::generate_n(n, streams.Split()); });
         return v;
       }
 
@@ -69,15 +83,15 @@ namespace testinator
   //------------------------------------------------------------------------------
   template <typename T, typename Compare, typename Alloc>
   struct Arbitrary<std::set<T, Compare, Alloc>>
-    : public Arbitrary_Assoc<std::set<T, Compare, Alloc>> {};
+    : public detail::Arbitrary_Assoc<std::set<T, Compare, Alloc>> {};
 
   template <typename T, typename Compare, typename Alloc>
   struct Arbitrary<std::multiset<T, Compare, Alloc>>
-    : public Arbitrary_Assoc<std::multiset<T, Compare, Alloc>> {};
+    : public detail::Arbitrary_Assoc<std::multiset<T, Compare, Alloc>> {};
 
   template <typename T, typename Hash, typename KeyEq, typename Alloc>
   struct Arbitrary<std::unordered_set<T, Hash, KeyEq, Alloc>>
-    : public Arbitrary_Assoc<std::unordered_set<T, Hash, KeyEq, Alloc>>
+    : public detail::Arbitrary_Assoc<std::unordered_set<T, Hash, KeyEq, Alloc>>
   {};
 
   //------------------------------------------------------------------------------
@@ -85,16 +99,16 @@ namespace testinator
   //------------------------------------------------------------------------------
   template <typename K, typename V, typename Compare, typename Alloc>
   struct Arbitrary<std::map<K, V, Compare, Alloc>>
-    : public Arbitrary_Assoc<std::map<K, V, Compare, Alloc>> {};
+    : public detail::Arbitrary_Assoc<std::map<K, V, Compare, Alloc>> {};
 
   template <typename K, typename V, typename Compare, typename Alloc>
   struct Arbitrary<std::multimap<K, V, Compare, Alloc>>
-    : public Arbitrary_Assoc<std::multimap<K, V, Compare, Alloc>>
+    : public detail::Arbitrary_Assoc<std::multimap<K, V, Compare, Alloc>>
   {};
 
   template <typename K, typename V, typename Hash, typename KeyEq, typename Alloc>
   struct Arbitrary<std::unordered_map<K, V, Hash, KeyEq, Alloc>>
-    : public Arbitrary_Assoc<std::unordered_map<K, V, Hash, KeyEq, Alloc>>
+    : public detail::Arbitrary_Assoc<std::unordered_map<K, V, Hash, KeyEq, Alloc>>
   {};
 
 }
@@ -0,0 +1,216 @@
+// Copyright (c) 2014-2016 Ben Deane
+// This code is distributed under the MIT license. See LICENSE for details.
+
+#pragma once
+
+#include "arbitrary.h"
+#include "rng.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace testinator
+{
+  //------------------------------------------------------------------------------
+  // Patterns of keys for unordered containers. Uniformly random keys rarely
+  // reach the slow paths of a hash table; these do. Colliding keys all fall in
+  // one bucket of the table (for its hasher, at its size), so lookups are
+  // linear; clustered keys come in runs of consecutive values, which trouble
+  // open addressing; sequential keys are consecutive from a random start. All
+  // but uniform keys need an integral key type, and colliding keys of other
+  // types are found by trial and error.
+  enum KeyPattern
+  {
+    KEYS_UNIFORM,
+    KEYS_COLLIDING,
+    KEYS_CLUSTERED,
+    KEYS_SEQUENTIAL
+  };
+
+  // An unordered container C, generated with keys in pattern P and with a
+  // maximum load factor of LOAD_PERCENT / 100 (sized so that filling it
+  // doesn't rehash). As a C, it can stand in for one as the argument of a
+  // property or complexity property:
+  //
+  //   DEF_COMPLEXITY_PROPERTY(Find, Hash, ORDER_1,
+  //                           const HashKeys<MyMap, KEYS_COLLIDING>& m)
+  //
+  // C needs the interface of the standard unordered containers (reserve,
+  // max_load_factor, bucket_count and bucket).
+  template <typename C, KeyPattern P, std::size_t LOAD_PERCENT = 100>
+  struct HashKeys : public C
+  {
+    using C::C;
+    HashKeys() = default;
+  };
+
+  namespace detail
+  {
+    template <typename C, typename = void>
+    struct is_map : public std::false_type {};
+
+    template <typename C>
+    struct is_map<C, decltype(void(std::declval<typename C::mapped_type>()))>
+      : public std::true_type {};
+
+    template <typename C>
+    inline void InsertKey(C& c, const typename C::key_type& k, std::size_t n,
+                          unsigned long int randomSeed, std::true_type /*map*/)
+    {
+      c.emplace(k, Arbitrary<typename C::mapped_type>::generate_n(n, randomSeed));
+    }
+
+    template <typename C>
+    inline void InsertKey(C& c, const typename C::key_type& k, std::size_t,
+                          unsigned long int, std::false_type /*map*/)
+    {
+      c.insert(k);
+    }
+
+    // Keys are generated as values past the edge cases of early generations
+    // (0, min and max), and without the size of generate_n: a long string
+    // would make hashing, not the table, the cost being measured.
+    template <typename K>
+    inline K RandomKey(SplitMix64& r)
+    {
+      return Arbitrary<K>::generate(3, r.Split());
+    }
+
+    // The key j places from k: integral keys step (wrapping) by j.
+    template <typename K>
+    inline K KeyAfter(K k, uint64_t j)
+    {
+      static_assert(std::is_integral<K>::value && !std::is_same<K, bool>::value,
+                    "clustered, sequential and (quickly) colliding keys must be integral");
+      using U = std::make_unsigned_t<K>;
+      return static_cast<K>(static_cast<U>(static_cast<U>(k) + static_cast<U>(j)));
+    }
+
+    // Colliding keys: random keys are tried until one lands in the first key's
+    // bucket. Integral keys first try stepping from the first key by the
+    // bucket count, which stays in its bucket for hashes that are (like
+    // std::hash for integers) the identity.
+    template <typename C>
+    inline typename C::key_type CollidingKey(
+        const C& c, const typename C::key_type& first, uint64_t,
+        SplitMix64& r, std::false_type /*integral*/)
+    {
+      using K = typename C::key_type;
+      // give up (and accept a key from another bucket) after many tries
+      std::size_t tries = 16 * c.bucket_count();
+      K k = RandomKey<K>(r);
+      while (c.bucket(k) != c.bucket(first) && --tries > 0)
+      {
+        k = RandomKey<K>(r);
+      }
+      return k;
+    }
+
+    template <typename C>
+    inline typename C::key_type CollidingKey(
+        const C& c, const typename C::key_type& first, uint64_t j,
+        SplitMix64& r, std::true_type /*integral*/)
+    {
+      using K = typename C::key_type;
+      K k = KeyAfter(first, j * c.bucket_count());
+      if (c.bucket(k) == c.bucket(first)) return k;
+      return CollidingKey(c, first, j, r, std::false_type{});
+    }
+  }
+
+  //------------------------------------------------------------------------------
+  template <typename C, KeyPattern P, std::size_t LOAD_PERCENT>
+  struct Arbitrary<HashKeys<C, P, LOAD_PERCENT>>
+  {
+    using output_type = HashKeys<C, P, LOAD_PERCENT>;
+    using K = typename C::key_type;
+
+    static const std::size_t N = 5;
+    // Clustered keys come in runs of this many.
+    static const std::size_t CLUSTER = 16;
+
+    static output_type generate(std::size_t generation, unsigned long int randomSeed)
+    {
+      if (generation == 0) return Empty(0);
+      return generate_n(ContainerSize(N, generation, randomSeed), randomSeed);
+    }
+
+    static output_type generate_n(std::size_t n, unsigned long int randomSeed)
+    {
+      output_type c = Empty(n);
+      SplitMix64 keys(randomSeed);
+      SplitMix64 values(keys.Split());
+      K first = detail::RandomKey<K>(keys);
+      K base = first;
+      // small key types may not have n distinct keys to give
+      for (uint64_t j = 0; c.size() < n && j < 16 * n + 16; ++j)
+      {
+        detail::InsertKey(c, Key(c, first, base, j, keys), n, values.Split(),
+                          detail::is_map<C>{});
+      }
+      return c;
+    }
+
+    static std::vector<output_type> shrink(const output_type& c)
+    {
+      std::vector<output_type> v;
+      if (c.empty()) return v;
+      auto l = c.size() / 2;
+      auto it = c.cbegin();
+      v.push_back(Empty(l));
+      for (decltype(l) count = 0; count < l; count++, it++)
+        v[0].insert(*it);
+      if (l > 0)
+      {
+        v.push_back(Empty(c.size() - l));
+        v[1].insert(it, c.cend());
+      }
+      return v;
+    }
+
+  private:
+    static output_type Empty(std::size_t n)
+    {
+      output_type c;
+      c.max_load_factor(static_cast<float>(LOAD_PERCENT) / 100.0f);
+      c.reserve(n);
+      return c;
+    }
+
+    // The j'th key tried; base is the start of the current cluster.
+    static K Key(const output_type& c, const K& first, K& base, uint64_t j,
+                 SplitMix64& keys)
+    {
+      return Key(c, first, base, j, keys, std::integral_constant<KeyPattern, P>{});
+    }
+
+    static K Key(const output_type&, const K& first, K&, uint64_t j,
+                 SplitMix64& keys, std::integral_constant<KeyPattern, KEYS_UNIFORM>)
+    {
+      return j == 0 ? first : detail::RandomKey<K>(keys);
+    }
+
+    static K Key(const output_type& c, const K& first, K&, uint64_t j,
+                 SplitMix64& keys, std::integral_constant<KeyPattern, KEYS_COLLIDING>)
+    {
+      if (j == 0) return first;
+      return detail::CollidingKey<C>(c, first, j, keys, std::is_integral<K>{});
+    }
+
+    static K Key(const output_type&, const K&, K& base, uint64_t j,
+                 SplitMix64& keys, std::integral_constant<KeyPattern, KEYS_CLUSTERED>)
+    {
+      if (j % CLUSTER == 0) base = detail::RandomKey<K>(keys);
+      return detail::KeyAfter(base, j % CLUSTER);
+    }
+
+    static K Key(const output_type&, const K& first, K&, uint64_t j,
+                 SplitMix64&, std::integral_constant<KeyPattern, KEYS_SEQUENTIAL>)
+    {
+      return detail::KeyAfter(first, j);
+    }
+  };
+}
@@ -0,0 +1,75 @@
+// Copyright (c) 2014-2016 Ben Deane
+// This code is distributed under the MIT license. See LICENSE for details.
+
+#pragma once
+
+// std::pmr needs C++17 and a library with <memory_resource>; without them this
+// header defines nothing, and TESTINATOR_PMR is not defined.
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+#define TESTINATOR_PMR
+#endif
+#endif
+
+#ifdef TESTINATOR_PMR
+
+#include "arbitrary.h"
+
+#include <memory_resource>
+#include <type_traits>
+
+namespace testinator
+{
+  //------------------------------------------------------------------------------
+  // The memory resource that pmr containers are generated from on this
+  // thread: std::pmr::get_default_resource(), unless a Scope sets another.
+  // A property does, with --arena: each check's arguments come from a
+  // monotonic_buffer_resource, released in one go when the check is done.
+  class GenerationResource
+  {
+  public:
+    static std::pmr::memory_resource* Current()
+    {
+      std::pmr::memory_resource* r = CurrentRef();
+      return r != nullptr ? r : std::pmr::get_default_resource();
+    }
+
+    // Sets the resource on this thread while in scope.
+    class Scope
+    {
+    public:
+      Scope(std::pmr::memory_resource* r) : m_previous(CurrentRef()) { CurrentRef() = r; }
+      ~Scope() { CurrentRef() = m_previous; }
+
+    private:
+      std::pmr::memory_resource* m_previous;
+    };
+
+  private:
+    static std::pmr::memory_resource*& CurrentRef()
+    {
+      thread_local std::pmr::memory_resource* s_resource = nullptr;
+      return s_resource;
+    }
+  };
+
+  //------------------------------------------------------------------------------
+  // pmr containers (std::pmr::vector, string, map and the rest) are generated
+  // by the same Arbitrary specializations as the others, since those take any
+  // allocator; this gives them their allocator, from GenerationResource. Pmr
+  // elements are generated from the same resource as their container, so
+  // they are moved into it without a copy.
+  template <typename C>
+  struct ContainerFactory<
+    C, std::enable_if_t<std::is_same<
+         typename C::allocator_type,
+         std::pmr::polymorphic_allocator<typename C::value_type>>::value>>
+  {
+    static C make()
+    {
+      return C(typename C::allocator_type(GenerationResource::Current()));
+    }
+  };
+}
+
+#endif
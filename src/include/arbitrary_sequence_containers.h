@@ -4,6 +4,8 @@
 #pragma once
 
 #include "arbitrary.h"
+#include "choice.h"
+#include "rng.h"
 
 #include <algorithm>
 #include <array>
@@ -12,12 +14,13 @@
 #include <forward_list>
 #include <iterator>
 #include <list>
+#include <type_traits>
 #include <vector>
 
 namespace testinator
 {
 
-  namespace
+  namespace detail
   {
     template <typename C>
     struct Arbitrary_RandomSequence
@@ -27,24 +30,90 @@ namespace testinator
 
       static C generate(std::size_t generation, unsigned long int randomSeed)
       {
-        C v;
+        C v = NewContainer<C>();
         if (generation == 0) return v;
-        std::size_t n = N * ((generation / 100) + 1);
-        std::generate_n(
-            std::back_inserter(v), n,
-            [&] () { return Arbitrary<V>::generate(generation++, randomSeed++); });
+        std::size_t n = ContainerSize(N, generation, randomSeed);
+        SplitMix64 streams(randomSeed);
+        GenerateElements(
+            n, [&] () { v.push_back(Arbitrary<V>::generate(generation++, streams.Split())); });
         return v;
       }
 
+      // The elements already there are regenerated in place, keeping their
+      // storage too; any left over are erased.
+      static void regenerate(C& v, std::size_t generation, unsigned long int randomSeed)
+      {
+        std::size_t i = 0;
+        if (generation != 0)
+        {
+          std::size_t n = ContainerSize(N, generation, randomSeed);
+          SplitMix64 streams(randomSeed);
+          GenerateElements(n, [&] () {
+              if (i < v.size())
+                RegenerateElement(v[i], generation++, streams.Split());
+              else
+                v.push_back(Arbitrary<V>::generate(generation++, streams.Split()));
+              ++i;
+            });
+        }
+        v.erase(v.begin() + static_cast<typename C::difference_type>(i), v.end());
+      }
+
+      static void RegenerateElement(V& e, std::size_t generation,
+                                    unsigned long int randomSeed)
+      {
+        Regenerate(e, generation, randomSeed);
+      }
+
+      // vector<bool>'s elements are proxies
+      template <typename Proxy>
+      static void RegenerateElement(Proxy&& e, std::size_t generation,
+                                    unsigned long int randomSeed)
+      {
+        e = Arbitrary<V>::generate(generation, randomSeed);
+      }
+
       static C generate_n(std::size_t n, unsigned long int randomSeed)
       {
-        C v;
+        return generate_n(n, randomSeed, has_generate_batch<V>{});
+      }
+
+      static C generate_n(std::size_t n, unsigned long int randomSeed,
+                          std::false_type)
+      {
+        C v = NewContainer<C>();
+        SplitMix64 streams(randomSeed);
         std::generate_n(
             std::back_inserter(v), n,
-            [&] () { return Arbitrary<V>::generate_n(n, randomSeed++); });
+            [&] () { return Arbitrary<V>::generate_n(n, streams.Split()); });
+        return v;
+      }
+
+      // Values that can be generated in bulk are generated straight into a
+      // vector's storage, or through a buffer for other containers.
+      static C generate_n(std::size_t n, unsigned long int randomSeed,
+                          std::true_type)
+      {
+        C v = NewContainer<C>();
+        v.resize(n);
+        Fill(v, n, randomSeed);
         return v;
       }
 
+      template <typename A>
+      static void Fill(std::vector<V, A>& v, std::size_t n, unsigned long int randomSeed)
+      {
+        GenerateBatch(v.data(), n, n, randomSeed);
+      }
+
+      template <typename D>
+      static void Fill(D& d, std::size_t n, unsigned long int randomSeed)
+      {
+        std::vector<V> buf(n);
+        GenerateBatch(buf.data(), n, n, randomSeed);
+        std::move(buf.begin(), buf.end(), d.begin());
+      }
+
       static std::vector<C> shrink(const C& c)
       {
         std::vector<C> v;
@@ -64,11 +133,11 @@ namespace testinator
   //------------------------------------------------------------------------------
   template <typename T, typename Alloc>
   struct Arbitrary<std::vector<T, Alloc>>
-    : public Arbitrary_RandomSequence<std::vector<T, Alloc>> {};
+    : public detail::Arbitrary_RandomSequence<std::vector<T, Alloc>> {};
 
   template <typename T, typename Alloc>
   struct Arbitrary<std::deque<T, Alloc>>
-    : public Arbitrary_RandomSequence<std::deque<T, Alloc>> {};
+    : public detail::Arbitrary_RandomSequence<std::deque<T, Alloc>> {};
 
   //------------------------------------------------------------------------------
   // specialization for list
@@ -82,19 +151,39 @@ namespace testinator
 
     static output_type generate(std::size_t generation, unsigned long int randomSeed)
     {
-      output_type v;
+      output_type v = NewContainer<output_type>();
       if (generation == 0) return v;
-      std::size_t n = N * ((generation / 100) + 1);
-      std::generate_n(std::back_inserter(v), n,
-                      [&] () { return Arbitrary<T>::generate(generation++, randomSeed++); });
+      std::size_t n = ContainerSize(N, generation, randomSeed);
+      SplitMix64 streams(randomSeed);
+      GenerateElements(
+          n, [&] () { v.push_back(Arbitrary<T>::generate(generation++, streams.Split())); });
       return v;
     }
 
+    static void regenerate(output_type& v, std::size_t generation,
+                           unsigned long int randomSeed)
+    {
+      auto it = v.begin();
+      if (generation != 0)
+      {
+        std::size_t n = ContainerSize(N, generation, randomSeed);
+        SplitMix64 streams(randomSeed);
+        GenerateElements(n, [&] () {
+            if (it != v.end())
+              Regenerate(*it++, generation++, streams.Split());
+            else
+              v.push_back(Arbitrary<T>::generate(generation++, streams.Split()));
+          });
+      }
+      v.erase(it, v.end());
+    }
+
     static output_type generate_n(std::size_t n, unsigned long int randomSeed)
     {
-      output_type v;
+      output_type v = NewContainer<output_type>();
+      SplitMix64 streams(randomSeed);
       std::generate_n(std::back_inserter(v), n,
-                      [&] () { return Arbitrary<T>::generate_n(n, randomSeed++); });
+                      [&] () { return Arbitrary<T>::generate_n(n, streams.Split()); });
       return v;
     }
 
@@ -128,19 +217,21 @@ namespace testinator
 
     static output_type generate(std::size_t generation, unsigned long int randomSeed)
     {
-      output_type v;
+      output_type v = NewContainer<output_type>();
       if (generation == 0) return v;
-      std::size_t n = N * ((generation / 100) + 1);
-      std::generate_n(std::front_inserter(v), n,
-                      [&] () { return Arbitrary<T>::generate(generation++, randomSeed++); });
+      std::size_t n = ContainerSize(N, generation, randomSeed);
+      SplitMix64 streams(randomSeed);
+      GenerateElements(
+          n, [&] () { v.push_front(Arbitrary<T>::generate(generation++, streams.Split())); });
       return v;
     }
 
     static output_type generate_n(std::size_t n, unsigned long int randomSeed)
     {
-      output_type v;
+      output_type v = NewContainer<output_type>();
+      SplitMix64 streams(randomSeed);
       std::generate_n(std::front_inserter(v), n,
-                      [&] () { return Arbitrary<T>::generate_n(n, randomSeed++); });
+                      [&] () { return Arbitrary<T>::generate_n(n, streams.Split()); });
       return v;
     }
 
@@ -174,12 +265,28 @@ namespace testinator
     {
       output_type v;
       if (generation == 0) return v;
+      SplitMix64 streams(randomSeed);
       std::generate_n(
           v.begin(), N,
-          [&] () { return Arbitrary<T>::generate(generation++, randomSeed++); });
+          [&] () { return Arbitrary<T>::generate(generation++, streams.Split()); });
       return v;
     }
 
+    static void regenerate(output_type& v, std::size_t generation,
+                           unsigned long int randomSeed)
+    {
+      if (generation == 0)
+      {
+        v = output_type{};
+        return;
+      }
+      SplitMix64 streams(randomSeed);
+      for (auto& e : v)
+      {
+        Regenerate(e, generation++, streams.Split());
+      }
+    }
+
     static output_type generate_n(std::size_t n, unsigned long int randomSeed)
     {
       return generate(n, randomSeed);
@@ -0,0 +1,211 @@
+// Copyright (c) 2014-2016 Ben Deane
+// This code is distributed under the MIT license. See LICENSE for details.
+
+#pragma once
+
+#include "arbitrary.h"
+#include "rng.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace testinator
+{
+  //------------------------------------------------------------------------------
+  // Shapes of input for sequences. Uniformly random elements are seldom the
+  // best or worst case of a sort or a search; these often are. A sorted or
+  // reversed sequence is in order (by operator<); a nearly-sorted one has each
+  // element at most K places from where it would be sorted; an organ-pipe one
+  // rises to its largest element and falls again; a few-unique one has at
+  // most K distinct elements; and an all-equal one has one.
+  enum InputShape
+  {
+    SHAPE_SORTED,
+    SHAPE_REVERSED,
+    SHAPE_NEARLY_SORTED,
+    SHAPE_ORGAN_PIPE,
+    SHAPE_FEW_UNIQUE,
+    SHAPE_ALL_EQUAL
+  };
+
+  // A sequence C (vector, deque, list, forward_list or string), generated as
+  // a C is and then put in shape S. As a C, it can stand in for one as the
+  // argument of a property or complexity property:
+  //
+  //   DEF_COMPLEXITY_PROPERTY(Sort, Shapes, ORDER_N_LOG_N,
+  //                           Shaped<vector<int>, SHAPE_ORGAN_PIPE> v)
+  template <typename C, InputShape S, std::size_t K = 8>
+  struct Shaped : public C
+  {
+    using C::C;
+    Shaped() = default;
+    explicit Shaped(C c) : C(std::move(c)) {}
+  };
+
+  namespace detail
+  {
+    // Shuffles [first, last) with randomness from r.
+    template <typename It>
+    inline void ShuffleWith(It first, It last, SplitMix64& r)
+    {
+      using D = typename std::iterator_traits<It>::difference_type;
+      for (D i = last - first - 1; i > 0; --i)
+      {
+        D j = static_cast<D>(r.Split() % static_cast<uint64_t>(i + 1));
+        std::iter_swap(first + i, first + j);
+      }
+    }
+
+    template <InputShape S, std::size_t K>
+    struct Shape;
+
+    template <std::size_t K>
+    struct Shape<SHAPE_SORTED, K>
+    {
+      template <typename It>
+      static void apply(It first, It last, SplitMix64&)
+      {
+        std::sort(first, last);
+      }
+    };
+
+    template <std::size_t K>
+    struct Shape<SHAPE_REVERSED, K>
+    {
+      template <typename It>
+      static void apply(It first, It last, SplitMix64&)
+      {
+        std::sort(first, last);
+        std::reverse(first, last);
+      }
+    };
+
+    // Shuffling within runs of K+1 moves no element further than K places.
+    template <std::size_t K>
+    struct Shape<SHAPE_NEARLY_SORTED, K>
+    {
+      template <typename It>
+      static void apply(It first, It last, SplitMix64& r)
+      {
+        using D = typename std::iterator_traits<It>::difference_type;
+        std::sort(first, last);
+        const D run = static_cast<D>(K + 1);
+        while (last - first > run)
+        {
+          ShuffleWith(first, first + run, r);
+          first += run;
+        }
+        ShuffleWith(first, last, r);
+      }
+    };
+
+    // The even places of the sorted sequence ascend, then the odd ones descend.
+    template <std::size_t K>
+    struct Shape<SHAPE_ORGAN_PIPE, K>
+    {
+      template <typename It>
+      static void apply(It first, It last, SplitMix64&)
+      {
+        using V = typename std::iterator_traits<It>::value_type;
+        std::vector<V> sorted(std::make_move_iterator(first), std::make_move_iterator(last));
+        std::sort(sorted.begin(), sorted.end());
+        for (std::size_t i = 0; i < sorted.size(); i += 2)
+        {
+          *first++ = std::move(sorted[i]);
+        }
+        for (std::size_t i = sorted.size() - sorted.size() % 2; i > 0; i -= 2)
+        {
+          *first++ = std::move(sorted[i - 1]);
+        }
+      }
+    };
+
+    // The first K elements are kept; each of the others becomes a copy of one.
+    template <std::size_t K>
+    struct Shape<SHAPE_FEW_UNIQUE, K>
+    {
+      static_assert(K > 0, "a few-unique sequence needs at least one value");
+
+      template <typename It>
+      static void apply(It first, It last, SplitMix64& r)
+      {
+        using D = typename std::iterator_traits<It>::difference_type;
+        const D k = std::min(static_cast<D>(K), last - first);
+        for (It i = first + k; i != last; ++i)
+        {
+          *i = first[static_cast<D>(r.Split() % static_cast<uint64_t>(k))];
+        }
+      }
+    };
+
+    template <std::size_t K>
+    struct Shape<SHAPE_ALL_EQUAL, K>
+    {
+      template <typename It>
+      static void apply(It first, It last, SplitMix64&)
+      {
+        if (first != last) std::fill(std::next(first), last, *first);
+      }
+    };
+
+    // Random access sequences are shaped in place; the others (lists) through
+    // a vector.
+    template <InputShape S, std::size_t K, typename C>
+    inline void ShapeSequence(C& c, SplitMix64& r, std::random_access_iterator_tag)
+    {
+      Shape<S, K>::apply(c.begin(), c.end(), r);
+    }
+
+    template <InputShape S, std::size_t K, typename C>
+    inline void ShapeSequence(C& c, SplitMix64& r, std::forward_iterator_tag)
+    {
+      std::vector<typename C::value_type> v(
+          std::make_move_iterator(c.begin()), std::make_move_iterator(c.end()));
+      Shape<S, K>::apply(v.begin(), v.end(), r);
+      std::move(v.begin(), v.end(), c.begin());
+    }
+  }
+
+  //------------------------------------------------------------------------------
+  template <typename C, InputShape S, std::size_t K>
+  struct Arbitrary<Shaped<C, S, K>>
+  {
+    using output_type = Shaped<C, S, K>;
+
+    static output_type generate(std::size_t generation, unsigned long int randomSeed)
+    {
+      return Reshape(Arbitrary<C>::generate(generation, randomSeed), randomSeed);
+    }
+
+    static output_type generate_n(std::size_t n, unsigned long int randomSeed)
+    {
+      return Reshape(Arbitrary<C>::generate_n(n, randomSeed), randomSeed);
+    }
+
+    // Shrinks as a C does, putting each smaller C back in shape.
+    static std::vector<output_type> shrink(const output_type& c)
+    {
+      std::vector<output_type> v;
+      for (auto& s : Arbitrary<C>::shrink(c))
+      {
+        v.push_back(Reshape(std::move(s), 0));
+      }
+      return v;
+    }
+
+  private:
+    static output_type Reshape(C c, unsigned long int randomSeed)
+    {
+      // the shape's randomness is separate from the elements'
+      SplitMix64 r(SplitMix64::Mix(~static_cast<uint64_t>(randomSeed) + 1));
+      detail::ShapeSequence<S, K>(
+          c, r, typename std::iterator_traits<typename C::iterator>::iterator_category{});
+      return output_type(std::move(c));
+    }
+  };
+}
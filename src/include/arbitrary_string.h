@@ -4,11 +4,14 @@
 #pragma once
 
 #include "arbitrary.h"
+#include "choice.h"
+#include "rng.h"
 
 #include <algorithm>
 #include <cstddef>
 #include <iterator>
 #include <string>
+#include <type_traits>
 
 namespace testinator
 {
@@ -26,21 +29,50 @@ namespace testinator
     static output_type generate(
         std::size_t generation, unsigned long int randomSeed)
     {
-      output_type s;
+      output_type s = NewContainer<output_type>();
       if (generation == 0) return s;
-      std::size_t n = N * ((generation / 100) + 1);
+      std::size_t n = ContainerSize(N, generation, randomSeed);
       s.reserve(n);
-      std::generate_n(std::back_inserter(s), n,
-                      [&] () { return Arbitrary<T>::generate(generation++, randomSeed++); });
+      SplitMix64 streams(randomSeed);
+      GenerateElements(
+          n, [&] () { s.push_back(Arbitrary<T>::generate(generation++, streams.Split())); });
       return s;
     }
 
+    static void regenerate(output_type& s, std::size_t generation,
+                           unsigned long int randomSeed)
+    {
+      s.clear();
+      if (generation == 0) return;
+      std::size_t n = ContainerSize(N, generation, randomSeed);
+      s.reserve(n);
+      SplitMix64 streams(randomSeed);
+      GenerateElements(
+          n, [&] () { s.push_back(Arbitrary<T>::generate(generation++, streams.Split())); });
+    }
+
     static output_type generate_n(std::size_t n, unsigned long int randomSeed)
     {
-      output_type s;
+      return generate_n(n, randomSeed, has_generate_batch<T>{});
+    }
+
+    static output_type generate_n(std::size_t n, unsigned long int randomSeed,
+                                  std::false_type)
+    {
+      output_type s = NewContainer<output_type>();
       s.reserve(n);
+      SplitMix64 streams(randomSeed);
       std::generate_n(std::back_inserter(s), n,
-                      [&] () { return Arbitrary<T>::generate_n(n, randomSeed++); });
+                      [&] () { return Arbitrary<T>::generate_n(n, streams.Split()); });
+      return s;
+    }
+
+    static output_type generate_n(std::size_t n, unsigned long int randomSeed,
+                                  std::true_type)
+    {
+      output_type s = NewContainer<output_type>();
+      s.assign(n, T{});
+      if (n > 0) GenerateBatch(&s[0], n, n, randomSeed);
       return s;
     }
 
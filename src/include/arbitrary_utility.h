@@ -4,8 +4,8 @@
 #pragma once
 
 #include "arbitrary.h"
+#include "rng.h"
 
-#include <random>
 #include <tuple>
 #include <type_traits>
 #include <utility>
@@ -16,10 +16,7 @@ namespace testinator
   {
     inline auto nextRandom(unsigned long int randomSeed)
     {
-      std::mt19937& gen = testinator::GetTestRegistry().RNG();
-      gen.seed(randomSeed);
-      std::uniform_int_distribution<unsigned long int> dis{};
-      return dis(gen);
+      return SplitMix64(randomSeed).Split();
     }
   }
 
@@ -39,6 +36,16 @@ namespace testinator
           Arbitrary<T2>::generate(generation, r2));
     }
 
+    static void regenerate(std::pair<T1, T2>& p, std::size_t generation,
+                           unsigned long int randomSeed)
+    {
+      auto r1 = randomSeed;
+      auto r2 = nextRandom(r1);
+
+      Regenerate(p.first, generation, r1);
+      Regenerate(p.second, generation, r2);
+    }
+
     static std::pair<T1, T2> generate_n(std::size_t n, unsigned long int randomSeed)
     {
       auto r1 = randomSeed;
@@ -124,6 +131,23 @@ namespace testinator
                         Arbitrary<T>::generate(n, r2));
     }
 
+    // Each element gets the seed generate gives it: the head gets the seed,
+    // and the tail the next one.
+    static void regenerate(std::tuple<Ts...>& t, std::size_t n,
+                           unsigned long int randomSeed)
+    {
+      regenerate(t, n, randomSeed, std::index_sequence_for<Ts...>{});
+    }
+
+    template <std::size_t... Is>
+    static void regenerate(std::tuple<Ts...>& t, std::size_t n,
+                           unsigned long int randomSeed, std::index_sequence<Is...>)
+    {
+      auto r = randomSeed;
+      int dummy[] = { (Regenerate(std::get<Is>(t), n, r), r = nextRandom(r), 0)... };
+      static_cast<void>(dummy);
+    }
+
     static std::tuple<Ts...> generate_n(std::size_t n, unsigned long int randomSeed)
     {
       auto r1 = randomSeed;
@@ -5,9 +5,11 @@
 
 #include <algorithm>
 #include <list>
+#include <mutex>
 #include <sstream>
 #include <stack>
 #include <string>
+#include <vector>
 
 namespace testinator
 {
@@ -30,6 +32,48 @@ namespace testinator
     return AtScopeExit<F>(std::forward<F>(f));
   }
 
+  //------------------------------------------------------------------------------
+  // The names of the branches a thread is in, copied out so that another thread
+  // (the watchdog) can read them safely while the test runs.
+  class BranchNames
+  {
+  public:
+    void push(const std::string& name)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_names.push_back(name);
+    }
+
+    void pop()
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (!m_names.empty()) m_names.pop_back();
+    }
+
+    void clear()
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_names.clear();
+    }
+
+    std::vector<std::string> get() const
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_names;
+    }
+
+    // Where the calling thread publishes its branch names, if anywhere.
+    static BranchNames*& current()
+    {
+      thread_local BranchNames* p = nullptr;
+      return p;
+    }
+
+  private:
+    mutable std::mutex m_mutex;
+    std::vector<std::string> m_names;
+  };
+
   //------------------------------------------------------------------------------
   class Branch
   {
@@ -96,10 +140,22 @@ namespace testinator
 
     static std::stack<Branch*>& getStack()
     {
-      static std::stack<Branch*> s;
+      thread_local std::stack<Branch*> s;
       return s;
     }
 
+    static void push(Branch* b)
+    {
+      getStack().push(b);
+      if (auto names = BranchNames::current()) names->push(b->getName());
+    }
+
+    static void pop()
+    {
+      getStack().pop();
+      if (auto names = BranchNames::current()) names->pop();
+    }
+
     static Branch& currentParent()
     {
       return *getStack().top();
@@ -123,7 +179,7 @@ namespace testinator
       if (m_canRun)
       {
         m_parent.setCanRunChild(false);
-        Branch::getStack().push(&m_child);
+        Branch::push(&m_child);
         m_child.setComplete(true);
       }
     }
@@ -169,7 +225,7 @@ namespace testinator
       __LINE__, __FILE__, TESTINATOR_BRANCH_NAME(#__VA_ARGS__));        \
   if (TESTINATOR_UNIQUE_NAME(rs).canRun())                              \
     if (auto TESTINATOR_UNIQUE_NAME(rspop) = testinator::at_scope_exit( \
-            [] () { testinator::Branch::getStack().pop(); }))
+            [] () { testinator::Branch::pop(); }))
 
 #define BRANCH_NAME (testinator::Branch::getStack().top()->getName())
 
@@ -178,10 +234,10 @@ namespace testinator
   inline bool Test::RunWithBranches()
   {
     Branch root(-1, "", "(root)");
-    Branch::getStack().push(&root);
+    Branch::push(&root);
     auto TESTINATOR_UNIQUE_NAME(rootpop) = at_scope_exit(
-        [] () { Branch::getStack().pop(); });
-    while (!root.isComplete())
+        [] () { Branch::pop(); });
+    while (!root.isComplete() && !CancellationRequested())
     {
       root.setComplete(true);
       if (!Run())
@@ -0,0 +1,41 @@
+// Copyright (c) 2014-2016 Ben Deane
+// This code is distributed under the MIT license. See LICENSE for details.
+
+#pragma once
+
+#include <atomic>
+
+namespace testinator
+{
+  //------------------------------------------------------------------------------
+  // Set to stop a run: running tests poll it and stop early, and no more tests
+  // are started. It is lock-free, so it may be set from a signal handler.
+  class CancellationToken
+  {
+  public:
+    // Returns false if the token was already cancelled.
+    bool Cancel() { return !m_cancelled.exchange(true); }
+    void Reset() { m_cancelled = false; }
+    bool IsCancelled() const { return m_cancelled.load(std::memory_order_relaxed); }
+
+    // For loops that stop early once cancelled: also notes that the work on
+    // this thread was cut short.
+    bool Poll() const
+    {
+      if (!IsCancelled()) return false;
+      Interrupted() = true;
+      return true;
+    }
+
+    // Whether work on this thread has been cut short by a cancellation since
+    // this was last reset.
+    static bool& Interrupted()
+    {
+      thread_local bool s_interrupted = false;
+      return s_interrupted;
+    }
+
+  private:
+    std::atomic<bool> m_cancelled{false};
+  };
+}
@@ -0,0 +1,265 @@
+// Copyright (c) 2014-2016 Ben Deane
+// This code is distributed under the MIT license. See LICENSE for details.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace testinator
+{
+  //------------------------------------------------------------------------------
+  // The random choices made while generating a value. While a ChoiceSequence is
+  // active on a thread, the Arbitrary primitives (arithmetic types, char, bool,
+  // and the decision to add each element to a container) pass their random
+  // draws through it: a recording sequence keeps them, and a replaying one
+  // substitutes its own. Replaying a sequence reproduces the value; replaying a
+  // smaller one (shorter, or with smaller choices) produces a simpler value,
+  // since each primitive maps a choice of 0 to its simplest value. So any type
+  // generated from the primitives can be shrunk by shrinking its choices.
+  class ChoiceSequence
+  {
+  public:
+    // Records the choices made.
+    ChoiceSequence() = default;
+
+    // Replays the given choices; past their end, every choice is 0.
+    explicit ChoiceSequence(std::vector<uint64_t> choices)
+      : m_choices(std::move(choices))
+      , m_replay(true)
+    {}
+
+    // Returns the choice to use in place of the random draw r.
+    uint64_t Draw(uint64_t r)
+    {
+      if (!m_replay)
+      {
+        m_choices.push_back(r);
+        return r;
+      }
+      return m_next < m_choices.size() ? m_choices[m_next++] : 0;
+    }
+
+    // The choices recorded, or those replayed so far.
+    std::vector<uint64_t> Choices() const
+    {
+      return m_replay
+        ? std::vector<uint64_t>(m_choices.cbegin(), m_choices.cbegin() + Used())
+        : m_choices;
+    }
+
+    void Clear()
+    {
+      m_choices.clear();
+      m_next = 0;
+    }
+
+    // The sequence active on this thread, or nullptr.
+    static ChoiceSequence* Active() { return ActiveRef(); }
+
+    // Makes a sequence active on this thread while in scope.
+    class Scope
+    {
+    public:
+      Scope(ChoiceSequence& c) : m_previous(ActiveRef()) { ActiveRef() = &c; }
+      ~Scope() { ActiveRef() = m_previous; }
+
+    private:
+      ChoiceSequence* m_previous;
+    };
+
+  private:
+    using difference_type = std::vector<uint64_t>::difference_type;
+
+    difference_type Used() const { return static_cast<difference_type>(m_next); }
+
+    static ChoiceSequence*& ActiveRef()
+    {
+      thread_local ChoiceSequence* s_active = nullptr;
+      return s_active;
+    }
+
+    std::vector<uint64_t> m_choices;
+    std::size_t m_next = 0;
+    bool m_replay = false;
+  };
+
+  //------------------------------------------------------------------------------
+  // Shrinks a sequence of choices for which fails(choices, used) holds, where
+  // used receives the choices actually read. A candidate is kept only if it
+  // fails and what it used is shorter, or as long and lexicographically
+  // smaller, so each step is progress. The passes delete runs of choices, zero
+  // them, and reduce single choices by binary search, until none makes
+  // progress.
+  //
+  // keepGoing(steps) is called before each evaluation; shrinking stops when
+  // it returns false. Returns the number of steps (improvements) taken.
+  template <typename Fails, typename KeepGoing>
+  inline std::size_t ShrinkChoices(std::vector<uint64_t>& choices,
+                                   Fails fails, KeepGoing keepGoing)
+  {
+    std::size_t steps = 0;
+    bool stopped = false;
+    std::vector<uint64_t> used;
+
+    auto better = [&] (const std::vector<uint64_t>& a) {
+      return a.size() < choices.size()
+        || (a.size() == choices.size() && a < choices);
+    };
+    auto attempt = [&] (const std::vector<uint64_t>& candidate) {
+      if (stopped || !keepGoing(steps))
+      {
+        stopped = true;
+        return false;
+      }
+      if (!fails(candidate, used) || !better(used)) return false;
+      choices = used;
+      ++steps;
+      return true;
+    };
+
+    bool progress = true;
+    while (progress && !stopped)
+    {
+      progress = false;
+
+      for (std::size_t k = 8; k > 0 && !stopped; k /= 2)
+      {
+        for (std::size_t i = 0; i + k <= choices.size() && !stopped; )
+        {
+          auto candidate = choices;
+          auto first = candidate.begin() + static_cast<std::ptrdiff_t>(i);
+          candidate.erase(first, first + static_cast<std::ptrdiff_t>(k));
+          if (attempt(candidate))
+            progress = true;
+          else
+            ++i;
+        }
+      }
+
+      for (std::size_t k = 8; k > 0 && !stopped; k /= 2)
+      {
+        for (std::size_t i = 0; i + k <= choices.size() && !stopped; ++i)
+        {
+          auto first = choices.cbegin() + static_cast<std::ptrdiff_t>(i);
+          if (std::all_of(first, first + static_cast<std::ptrdiff_t>(k),
+                          [] (uint64_t c) { return c == 0; }))
+            continue;
+          auto candidate = choices;
+          std::fill_n(candidate.begin() + static_cast<std::ptrdiff_t>(i), k, 0);
+          progress = attempt(candidate) || progress;
+        }
+      }
+
+      for (std::size_t i = 0; i < choices.size() && !stopped; ++i)
+      {
+        // Find the smallest choice here that still fails, assuming that
+        // smaller choices fail less often. The low bit is kept, since for
+        // signed values it is the sign; then one less is tried, which flips it.
+        const uint64_t low = choices[i] & 1;
+        uint64_t lo = 0;
+        uint64_t hi = choices[i] >> 1;
+        while (lo < hi && !stopped)
+        {
+          auto candidate = choices;
+          uint64_t mid = lo + (hi - lo) / 2;
+          candidate[i] = (mid << 1) | low;
+          if (attempt(candidate))
+          {
+            progress = true;
+            if (i >= choices.size() || (choices[i] & 1) != low) break;
+            hi = choices[i] >> 1;
+          }
+          else
+          {
+            lo = mid + 1;
+          }
+        }
+        if (i < choices.size() && choices[i] > 0)
+        {
+          auto candidate = choices;
+          --candidate[i];
+          progress = attempt(candidate) || progress;
+        }
+      }
+    }
+    return steps;
+  }
+
+  //------------------------------------------------------------------------------
+  // Decodes bytes (from a fuzzer, say) into choices, each a little-endian
+  // base-128 varint: 7 bits per byte, with the high bit set on all but the last
+  // byte. So small choices (flags, short lengths, small values) take one byte,
+  // and any byte string decodes to some sequence. Bits beyond 64 are dropped.
+  inline std::vector<uint64_t> ChoicesFromBytes(const uint8_t* data, std::size_t size)
+  {
+    std::vector<uint64_t> choices;
+    choices.reserve(size);
+    for (std::size_t i = 0; i < size; )
+    {
+      uint64_t c = 0;
+      for (unsigned shift = 0; i < size; shift += 7)
+      {
+        uint8_t b = data[i++];
+        if (shift < 64) c |= static_cast<uint64_t>(b & 0x7fu) << shift;
+        if ((b & 0x80u) == 0) break;
+      }
+      choices.push_back(c);
+    }
+    return choices;
+  }
+
+  //------------------------------------------------------------------------------
+  // Mutates a sequence of choices for coverage-guided checking, with one random
+  // edit half the time, and two to four otherwise: replacing a choice with a
+  // random, small, or nearby value, flipping a bit, deleting or duplicating a
+  // run, or splicing in the tail of another sequence. Since every primitive
+  // accepts any choice (and replaying past the end gives 0s), any sequence
+  // generates some value.
+  template <typename RNG>
+  inline std::vector<uint64_t> MutateChoices(std::vector<uint64_t> choices,
+                                             const std::vector<uint64_t>& other,
+                                             RNG& r)
+  {
+    using diff = std::ptrdiff_t;
+    for (auto edits = r() % 2 == 0 ? 1 : 2 + r() % 3; edits > 0; --edits)
+    {
+      if (choices.empty())
+      {
+        choices.push_back(r());
+        continue;
+      }
+      std::size_t i = static_cast<std::size_t>(r() % choices.size());
+      std::size_t k = std::min<std::size_t>(
+          1 + static_cast<std::size_t>(r() % 8), choices.size() - i);
+      auto first = choices.begin() + static_cast<diff>(i);
+      switch (r() % 7)
+      {
+        case 0: choices[i] = r(); break;
+        case 1: choices[i] = r() % 256; break;
+        case 2: choices[i] += 1 + r() % 16; break;
+        case 3: choices[i] -= 1 + r() % 16; break;
+        case 4: choices[i] ^= uint64_t{1} << (r() % 64); break;
+        case 5: choices.erase(first, first + static_cast<diff>(k)); break;
+        case 6:
+        {
+          std::vector<uint64_t> run(first, first + static_cast<diff>(k));
+          choices.insert(choices.begin() + static_cast<diff>(i + k),
+                         run.cbegin(), run.cend());
+          break;
+        }
+        default: break;
+      }
+      if (!other.empty() && r() % 8 == 0)
+      {
+        std::size_t j = static_cast<std::size_t>(r() % other.size());
+        choices.resize(std::min(i, choices.size()));
+        choices.insert(choices.end(), other.cbegin() + static_cast<diff>(j), other.cend());
+      }
+    }
+    return choices;
+  }
+}
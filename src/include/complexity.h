@@ -111,16 +111,17 @@ namespace testinator
     {
     }
 
-    int check(std::size_t N)
+    // Stops early (giving ORDER_1) if the token is cancelled.
+    int check(std::size_t N, const CancellationToken* token = nullptr)
     {
-      return m_internal->check(N);
+      return m_internal->check(N, token);
     }
 
   private:
     struct InternalBase
     {
       virtual ~InternalBase() {}
-      virtual int check(std::size_t N) = 0;
+      virtual int check(std::size_t N, const CancellationToken*) = 0;
     };
 
     template <typename U>
@@ -130,13 +131,14 @@ namespace testinator
 
       Internal(const U& u) : m_u(u) {}
 
-      virtual int check(std::size_t N) override
+      virtual int check(std::size_t N, const CancellationToken* token) override
       {
         // Get the timings for N and N * MULTIPLIER, NUM_ITER samples each
         int64_t countsN[NUM_ITER];
         int64_t countsMultN[NUM_ITER];
         for (std::size_t i = 0; i < NUM_ITER; ++i)
         {
+          if (token != nullptr && token->Poll()) return ORDER_1;
           countsN[i] = checkInternal(N, N);
           countsMultN[i] = checkInternal(N, N * MULTIPLIER);
         }
@@ -171,7 +173,7 @@ namespace testinator
     virtual bool Run() override                                         \
     {                                                                   \
       testinator::ComplexityProperty p(*this);                          \
-      int order = p.check(m_numChecks);                                 \
+      int order = p.check(m_numChecks, &Cancellation());                \
       bool success = (order <= testinator::ORDER);                      \
       if (!success)                                                     \
       {                                                                 \
@@ -185,6 +187,10 @@ namespace testinator
       }                                                                 \
       return success;                                                   \
     }                                                                   \
+    virtual const char* GetType() const override                        \
+    { return "COMPLEXITY_PROPERTY"; }                                   \
+    virtual bool IsExclusive() const override                           \
+    { return true; }                                                    \
     void operator()(__VA_ARGS__);                                       \
   } s_##SUITE##NAME##_ComplexityProperty;                               \
   void SUITE##NAME##ComplexityProperty::operator()(__VA_ARGS__)
@@ -0,0 +1,143 @@
+// Copyright (c) 2014-2016 Ben Deane
+// This code is distributed under the MIT license. See LICENSE for details.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Edge coverage for coverage-guided property checks (see --guided). Code built
+// with -fsanitize-coverage=trace-pc-guard (clang) or trace-pc (gcc), in a
+// program built with TESTINATOR_COVERAGE defined, counts its hits in a map of
+// 8-bit counters: with guards, one per edge; otherwise one per hashed
+// location. Hits from every thread go to the same map, so guided checks are
+// best run with --jobs=1.
+//
+// The callbacks are defined (weakly, so that every file including this may
+// define them) only with TESTINATOR_COVERAGE; they must not be instrumented
+// themselves, and neither must anything they call. Nor is the map's own
+// upkeep, which would otherwise count itself.
+
+#if defined(__clang__)
+#define TESTINATOR_NO_COVERAGE __attribute__((no_sanitize("coverage")))
+#elif defined(__GNUC__) && __GNUC__ >= 12
+#define TESTINATOR_NO_COVERAGE __attribute__((no_sanitize_coverage))
+#else
+#define TESTINATOR_NO_COVERAGE
+#endif
+
+namespace testinator
+{
+  namespace detail
+  {
+    // A class template's static members give a header-only library one
+    // instance of the map, reachable from the callbacks without a call.
+    template <typename = void>
+    struct CoverageCounters
+    {
+      static const std::size_t SIZE = std::size_t{1} << 16;
+      static uint8_t s_counters[SIZE];
+      static uint32_t s_numGuards;
+      static bool s_instrumented;
+    };
+
+    template <typename T>
+    uint8_t CoverageCounters<T>::s_counters[SIZE];
+    template <typename T>
+    uint32_t CoverageCounters<T>::s_numGuards = 0;
+    template <typename T>
+    bool CoverageCounters<T>::s_instrumented = false;
+  }
+
+  //------------------------------------------------------------------------------
+  class CoverageMap
+  {
+  public:
+    using Counters = detail::CoverageCounters<>;
+    static const std::size_t SIZE = Counters::SIZE;
+
+    // Whether any instrumented code has run (or been loaded).
+    static bool Instrumented() { return Counters::s_instrumented; }
+
+    TESTINATOR_NO_COVERAGE static void Reset()
+    {
+      std::memset(Counters::s_counters, 0, SIZE);
+    }
+
+    // Adds the hits since Reset to seen, which has SIZE entries. As in AFL,
+    // hit counts are bucketed (1, 2, 3, 4-7, 8-15, 16-31, 32-127, 128+) and
+    // each bucket of each edge is new coverage. Returns whether any was new.
+    TESTINATOR_NO_COVERAGE static bool Merge(std::vector<uint8_t>& seen)
+    {
+      // most of the map is untouched, so it is scanned a word at a time
+      bool found = false;
+      for (std::size_t w = 0; w < SIZE; w += sizeof(uint64_t))
+      {
+        uint64_t word;
+        std::memcpy(&word, Counters::s_counters + w, sizeof(word));
+        if (word == 0) continue;
+        for (std::size_t i = w; i < w + sizeof(uint64_t); ++i)
+        {
+          uint8_t c = Counters::s_counters[i];
+          if (c == 0) continue;
+          uint8_t bucket = Bucket(c);
+          if ((seen[i] & bucket) == 0)
+          {
+            seen[i] = static_cast<uint8_t>(seen[i] | bucket);
+            found = true;
+          }
+        }
+      }
+      return found;
+    }
+
+  private:
+    TESTINATOR_NO_COVERAGE static uint8_t Bucket(uint8_t c)
+    {
+      if (c < 4) return static_cast<uint8_t>(1u << (c - 1));
+      if (c < 8) return 1u << 3;
+      if (c < 16) return 1u << 4;
+      if (c < 32) return 1u << 5;
+      if (c < 128) return 1u << 6;
+      return 1u << 7;
+    }
+  };
+}
+
+#ifdef TESTINATOR_COVERAGE
+
+extern "C" __attribute__((weak)) TESTINATOR_NO_COVERAGE
+void __sanitizer_cov_trace_pc_guard_init(uint32_t* start, uint32_t* stop)
+{
+  using C = testinator::detail::CoverageCounters<>;
+  if (start == stop || *start != 0) return;
+  C::s_instrumented = true;
+  for (uint32_t* g = start; g < stop; ++g)
+  {
+    // guard 0 means "don't count", so edges are numbered from 1
+    *g = static_cast<uint32_t>(C::s_numGuards++ % (C::SIZE - 1) + 1);
+  }
+}
+
+extern "C" __attribute__((weak)) TESTINATOR_NO_COVERAGE
+void __sanitizer_cov_trace_pc_guard(uint32_t* guard)
+{
+  using C = testinator::detail::CoverageCounters<>;
+  uint8_t& c = C::s_counters[*guard];
+  if (c != UINT8_MAX) ++c;
+}
+
+extern "C" __attribute__((weak)) TESTINATOR_NO_COVERAGE
+void __sanitizer_cov_trace_pc()
+{
+  using C = testinator::detail::CoverageCounters<>;
+  C::s_instrumented = true;
+  auto pc = reinterpret_cast<uintptr_t>(__builtin_return_address(0));
+  uint8_t& c = C::s_counters[(pc ^ (pc >> 16)) & (C::SIZE - 1)];
+  if (c != UINT8_MAX) ++c;
+}
+
+#endif
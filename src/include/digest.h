@@ -0,0 +1,193 @@
+// Copyright (c) 2014-2016 Ben Deane
+// This code is distributed under the MIT license. See LICENSE for details.
+
+#pragma once
+
+#include "prettyprint.h"
+#include "rng.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace testinator
+{
+  //------------------------------------------------------------------------------
+  // A digest of a value, for telling whether a value has been seen before
+  // without keeping it. Types with a std::hash use it; pairs, tuples and
+  // vectors combine the digests of their elements; anything else is digested
+  // by its prettyprinted form. Digester<T>::digest returns false for a value
+  // with no usable digest: one whose prettyprinted form doesn't show its value
+  // (like "<class>"), since every such value would look the same.
+  namespace detail
+  {
+    template <typename T, typename = void>
+    struct is_std_hashable : public std::false_type {};
+
+    template <typename T>
+    struct is_std_hashable<
+      T, decltype(void(std::hash<T>{}(std::declval<const T&>())))>
+      : public std::true_type {};
+
+    inline std::size_t CombineDigest(std::size_t seed, std::size_t d)
+    {
+      return static_cast<std::size_t>(
+          SplitMix64::Mix(seed ^ (d + 0x9e3779b97f4a7c15ull)));
+    }
+
+    // Whether prettyprint shows a T's value.
+    template <typename T, typename TAG = stringifier_tag<std::remove_cv_t<T>>>
+    struct prints_value : public std::false_type {};
+
+    template <typename T>
+    struct prints_value<T, is_outputtable_tag> : public std::true_type {};
+
+    template <typename T>
+    struct prints_value<T, is_enum_tag> : public std::true_type {};
+
+    template <typename T>
+    struct prints_value<T, is_iterable_tag>
+      : public prints_value<std::decay_t<decltype(*std::declval<T>().begin())>> {};
+
+    template <typename T, typename U>
+    struct prints_value<std::pair<T, U>, is_pair_tag>
+      : public std::integral_constant<
+          bool, prints_value<T>::value && prints_value<U>::value> {};
+
+    template <typename T>
+    struct prints_value<std::tuple<T>, is_tuple_tag> : public prints_value<T> {};
+
+    template <typename T, typename... Ts>
+    struct prints_value<std::tuple<T, Ts...>, is_tuple_tag>
+      : public std::integral_constant<
+          bool, prints_value<T>::value && prints_value<std::tuple<Ts...>>::value> {};
+
+    template <typename T>
+    inline bool DigestPrinted(const T& t, std::size_t& d, std::true_type)
+    {
+      std::ostringstream s;
+      s << prettyprint(t);
+      d = std::hash<std::string>{}(s.str());
+      return true;
+    }
+
+    template <typename T>
+    inline bool DigestPrinted(const T&, std::size_t&, std::false_type)
+    {
+      return false;
+    }
+  }
+
+  template <typename T, typename = void>
+  struct Digester
+  {
+    static bool digest(const T& t, std::size_t& d)
+    {
+      return detail::DigestPrinted(t, d, detail::prints_value<T>{});
+    }
+  };
+
+  template <typename T>
+  struct Digester<T, std::enable_if_t<detail::is_std_hashable<T>::value>>
+  {
+    static bool digest(const T& t, std::size_t& d)
+    {
+      d = std::hash<T>{}(t);
+      return true;
+    }
+  };
+
+  template <typename T>
+  inline bool Digest(const T& t, std::size_t& d)
+  {
+    return Digester<T>::digest(t, d);
+  }
+
+  //------------------------------------------------------------------------------
+  template <typename T, typename A>
+  struct Digester<std::vector<T, A>,
+                  std::enable_if_t<!detail::is_std_hashable<std::vector<T, A>>::value>>
+  {
+    static bool digest(const std::vector<T, A>& v, std::size_t& d)
+    {
+      d = v.size();
+      for (const auto& e : v)
+      {
+        std::size_t de;
+        if (!Digest(e, de)) return false;
+        d = detail::CombineDigest(d, de);
+      }
+      return true;
+    }
+  };
+
+  template <typename T, typename U>
+  struct Digester<std::pair<T, U>>
+  {
+    static bool digest(const std::pair<T, U>& p, std::size_t& d)
+    {
+      std::size_t d1, d2;
+      if (!Digest(p.first, d1) || !Digest(p.second, d2)) return false;
+      d = detail::CombineDigest(d1, d2);
+      return true;
+    }
+  };
+
+  template <typename... Ts>
+  struct Digester<std::tuple<Ts...>>
+  {
+    static bool digest(const std::tuple<Ts...>& t, std::size_t& d)
+    {
+      return digest(t, d, std::index_sequence_for<Ts...>{});
+    }
+
+  private:
+    template <std::size_t... Is>
+    static bool digest(const std::tuple<Ts...>& t, std::size_t& d,
+                       std::index_sequence<Is...>)
+    {
+      d = sizeof...(Ts);
+      bool ok = true;
+      std::size_t ds[] = { 0, Element(std::get<Is>(t), ok)... };
+      for (std::size_t i = 1; i < sizeof(ds) / sizeof(ds[0]); ++i)
+      {
+        d = detail::CombineDigest(d, ds[i]);
+      }
+      return ok;
+    }
+
+    template <typename E>
+    static std::size_t Element(const E& e, bool& ok)
+    {
+      std::size_t d = 0;
+      ok = Digest(e, d) && ok;
+      return d;
+    }
+  };
+
+  //------------------------------------------------------------------------------
+  // The digests of the values evaluated so far. Insert returns false for a
+  // value seen before; a value with no digest is never considered seen.
+  // Different values with the same digest are taken to be the same, which for
+  // a 64-bit digest is vanishingly unlikely, and at worst skips one candidate.
+  class SeenSet
+  {
+  public:
+    template <typename T>
+    bool Insert(const T& t)
+    {
+      std::size_t d;
+      return !Digest(t, d) || m_digests.insert(d).second;
+    }
+
+  private:
+    std::unordered_set<std::size_t> m_digests;
+  };
+}
@@ -0,0 +1,126 @@
+// Copyright (c) 2014-2016 Ben Deane
+// This code is distributed under the MIT license. See LICENSE for details.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace testinator
+{
+  //------------------------------------------------------------------------------
+  // Durations of tests from previous runs, keyed by suite and test name. The
+  // file format is one test per line: suite name, test name and duration in
+  // nanoseconds, separated by tabs.
+  class DurationHistory
+  {
+  public:
+    using Duration = std::chrono::nanoseconds;
+
+    bool Load(const std::string& filename)
+    {
+      std::ifstream ifs(filename);
+      if (!ifs) return false;
+
+      std::string line;
+      while (std::getline(ifs, line))
+      {
+        auto tab1 = line.find('\t');
+        if (tab1 == std::string::npos) continue;
+        auto tab2 = line.find('\t', tab1 + 1);
+        if (tab2 == std::string::npos) continue;
+        char* end;
+        auto ns = strtoll(line.c_str() + tab2 + 1, &end, 10);
+        if (end == line.c_str() + tab2 + 1) continue;
+        m_durations[{line.substr(0, tab1), line.substr(tab1 + 1, tab2 - tab1 - 1)}] =
+          Duration(ns);
+      }
+      return true;
+    }
+
+    bool Save(const std::string& filename) const
+    {
+      std::ofstream ofs(filename, std::ios::trunc);
+      for (const auto& i : m_durations)
+      {
+        ofs << i.first.first << '\t' << i.first.second << '\t'
+            << i.second.count() << '\n';
+      }
+      return static_cast<bool>(ofs);
+    }
+
+    bool Lookup(const std::string& suiteName, const std::string& testName,
+                Duration& d) const
+    {
+      auto i = m_durations.find({suiteName, testName});
+      if (i == m_durations.end()) return false;
+      d = i->second;
+      return true;
+    }
+
+    // The mean recorded duration, used as the expected cost of tests that have
+    // no recorded duration.
+    Duration Mean() const
+    {
+      if (m_durations.empty()) return Duration::zero();
+      Duration total = Duration::zero();
+      for (const auto& i : m_durations)
+      {
+        total += i.second;
+      }
+      return total / static_cast<Duration::rep>(m_durations.size());
+    }
+
+    // A new measurement is averaged with the recorded one, so that a single
+    // noisy run doesn't reorder the schedule too much.
+    void Record(const std::string& suiteName, const std::string& testName,
+                Duration d)
+    {
+      auto i = m_durations.find({suiteName, testName});
+      if (i == m_durations.end())
+        m_durations.insert({{suiteName, testName}, d});
+      else
+        i->second = (i->second + d) / 2;
+    }
+
+    bool empty() const { return m_durations.empty(); }
+
+  private:
+    std::map<std::pair<std::string, std::string>, Duration> m_durations;
+  };
+
+  //------------------------------------------------------------------------------
+  // The wall time of running tests with the given durations, in the given
+  // order, on numJobs workers that each take the next test when they become
+  // free.
+  inline DurationHistory::Duration PredictCriticalPath(
+      const std::vector<DurationHistory::Duration>& costs, std::size_t numJobs)
+  {
+    using Duration = DurationHistory::Duration;
+    std::priority_queue<Duration, std::vector<Duration>, std::greater<Duration>>
+      workers;
+    for (std::size_t i = 0; i < std::max(numJobs, std::size_t{1}); ++i)
+    {
+      workers.push(Duration::zero());
+    }
+
+    Duration criticalPath = Duration::zero();
+    for (auto c : costs)
+    {
+      Duration finish = workers.top() + c;
+      workers.pop();
+      workers.push(finish);
+      criticalPath = std::max(criticalPath, finish);
+    }
+    return criticalPath;
+  }
+}
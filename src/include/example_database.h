@@ -0,0 +1,122 @@
+// Copyright (c) 2014-2016 Ben Deane
+// This code is distributed under the MIT license. See LICENSE for details.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+namespace testinator
+{
+  //------------------------------------------------------------------------------
+  // A failing case of a property, as stored in the example database: the seed
+  // and check index it was generated from, the generation size in force, and
+  // the choices (see ChoiceSequence) that regenerate it. m_description is the
+  // failing value as printed, for the reader of the file.
+  struct Example
+  {
+    unsigned long m_seed = 0;
+    std::size_t m_check = 0;
+    std::size_t m_size = 0;
+    std::vector<uint64_t> m_choices;
+    std::string m_description;
+  };
+
+  //------------------------------------------------------------------------------
+  // The example database is a directory with a file for each property that
+  // has failed, named for its suite and test. Each property reads and writes
+  // only its own file, so properties running on other threads or in other
+  // processes don't interfere. The file format is one example per line: seed,
+  // check index and size, then the choices separated by spaces, with tabs
+  // between the fields. A line starting with '#' is a comment; each example is
+  // preceded by one showing its value.
+  inline std::string ExampleFile(const std::string& directory,
+                                 const std::string& suiteName,
+                                 const std::string& testName)
+  {
+    std::string name = suiteName + '.' + testName;
+    for (auto& c : name)
+    {
+      bool safe = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+        || (c >= '0' && c <= '9') || c == '_' || c == '.' || c == '-';
+      if (!safe) c = '_';
+    }
+    return directory + '/' + name;
+  }
+
+  inline std::vector<Example> LoadExamples(const std::string& filename)
+  {
+    std::vector<Example> examples;
+    std::ifstream ifs(filename);
+    std::string line;
+    while (std::getline(ifs, line))
+    {
+      if (line.empty() || line[0] == '#') continue;
+      std::istringstream iss(line);
+      Example e;
+      if (!(iss >> e.m_seed >> e.m_check >> e.m_size)) continue;
+      uint64_t c;
+      while (iss >> c)
+      {
+        e.m_choices.push_back(c);
+      }
+      examples.push_back(std::move(e));
+    }
+    return examples;
+  }
+
+  // Saving no examples removes the file.
+  inline bool SaveExamples(const std::string& filename,
+                           const std::vector<Example>& examples)
+  {
+    if (examples.empty())
+    {
+      std::remove(filename.c_str());
+      return true;
+    }
+
+    auto slash = filename.find_last_of('/');
+    if (slash != std::string::npos)
+    {
+      std::string directory = filename.substr(0, slash);
+#ifdef _WIN32
+      _mkdir(directory.c_str());
+#else
+      mkdir(directory.c_str(), 0777);
+#endif
+    }
+
+    std::ofstream ofs(filename, std::ios::trunc);
+    for (const auto& e : examples)
+    {
+      if (!e.m_description.empty())
+      {
+        std::string d = e.m_description;
+        std::replace(d.begin(), d.end(), '\n', ' ');
+        ofs << "# " << d << '\n';
+      }
+      ofs << e.m_seed << '\t' << e.m_check << '\t' << e.m_size << '\t';
+      for (std::size_t i = 0; i < e.m_choices.size(); ++i)
+      {
+        if (i > 0) ofs << ' ';
+        ofs << e.m_choices[i];
+      }
+      ofs << '\n';
+    }
+    return static_cast<bool>(ofs);
+  }
+}
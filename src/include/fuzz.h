@@ -0,0 +1,102 @@
+// Copyright (c) 2014-2016 Ben Deane
+// This code is distributed under the MIT license. See LICENSE for details.
+
+#pragma once
+
+#include "property.h"
+#include "test.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Runs a property as a libFuzzer target. Build the property's source with
+// TESTINATOR_FUZZ_MAIN defined (instead of TESTINATOR_MAIN) and with
+// -fsanitize=fuzzer, which supplies main (see TESTINATOR_ADD_FUZZER in
+// CMakeLists.txt). Each input is decoded as choices for the property's
+// Arbitrary generators (see CheckBytes), so a property fuzzes without a
+// generator of its own, and a failure is printed as a value before the
+// fuzzer aborts and saves the input.
+//
+// The property to fuzz is named (as for --testName) by the environment
+// variable TESTINATOR_PROPERTY; it may be left unset if only one property is
+// registered.
+
+namespace testinator
+{
+  // The properties that can be fuzzed: those of DEF_PROPERTY. Complexity
+  // properties are PropertyTests too, but have no use for the input.
+  inline const PropertyTest* Fuzzable(const Test* t)
+  {
+    if (std::strcmp(t->GetType(), "PROPERTY") != 0) return nullptr;
+    return dynamic_cast<const PropertyTest*>(t);
+  }
+
+  // Returns the property named name (or, if name is null or empty, the only
+  // property), or nullptr if there isn't exactly one.
+  inline PropertyTest* FuzzTarget(const char* name)
+  {
+    PropertyTest* target = nullptr;
+    std::size_t matches = 0;
+    for (auto t : TestRegistry::Instance().GetTests())
+    {
+      auto p = Fuzzable(t);
+      if (p == nullptr) continue;
+      if (name != nullptr && *name != '\0' && p->GetName() != name) continue;
+      // the registry hands out tests to be looked at; a fuzzer runs one
+      target = const_cast<PropertyTest*>(p);
+      ++matches;
+    }
+    return matches == 1 ? target : nullptr;
+  }
+
+  inline int FuzzInitialize(PropertyTest*& target)
+  {
+    const char* name = std::getenv("TESTINATOR_PROPERTY");
+    target = FuzzTarget(name);
+    if (target != nullptr) return 0;
+
+    std::cerr << "Set TESTINATOR_PROPERTY to one of these properties:\n";
+    for (auto t : TestRegistry::Instance().GetTests())
+    {
+      if (Fuzzable(t) != nullptr)
+        std::cerr << "  " << t->GetName() << " (" << t->GetSuiteName() << ")\n";
+    }
+    std::exit(1);
+  }
+
+  inline int FuzzOne(PropertyTest* target, const uint8_t* data, std::size_t size)
+  {
+    std::ostringstream failure;
+    if (target->CheckBytes(data, size, &failure)) return 0;
+
+    std::cerr << "FAIL: " << target->GetName() << " (" << target->GetSuiteName()
+              << ") on " << failure.str() << std::endl;
+    std::abort();
+  }
+}
+
+#ifdef TESTINATOR_FUZZ_MAIN
+
+namespace
+{
+  testinator::PropertyTest* s_fuzzTarget = nullptr;
+}
+
+extern "C" int LLVMFuzzerInitialize(int*, char***)
+{
+  return testinator::FuzzInitialize(s_fuzzTarget);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, std::size_t size)
+{
+  return testinator::FuzzOne(s_fuzzTarget, data, size);
+}
+
+#endif
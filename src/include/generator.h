@@ -0,0 +1,441 @@
+// Copyright (c) 2014-2016 Ben Deane
+// This code is distributed under the MIT license. See LICENSE for details.
+
+#pragma once
+
+#include "arbitrary.h"
+#include "choice.h"
+#include "rng.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace testinator
+{
+  //------------------------------------------------------------------------------
+  // Generators: values with the interface of an Arbitrary (generate,
+  // generate_n and shrink, as const members, and an output_type), built up
+  // from smaller ones by the combinators in namespace gen:
+  //
+  //   auto point = gen::Map(gen::InRange(0, 99), [] (int x) { return Point{x, -x}; });
+  //
+  // A combinator's type holds the types of its parts, and nothing is virtual
+  // or type-erased, so a composed generator inlines like a hand-written
+  // Arbitrary. An Arbitrary specialization can be made from one with
+  // ArbitraryFromGenerator (below).
+  //
+  // Every random choice a generator makes goes through the active choice
+  // sequence (see choice.h), and a choice of 0 gives the simplest option (the
+  // bottom of a range, the first element or generator), so with
+  // --shrinkChoices any generator shrinks. Otherwise, generators that can't
+  // tell which part made a value (Map, Bind, OneOf and Frequency) don't shrink.
+  namespace gen
+  {
+    namespace detail
+    {
+      // A choice of 0 .. bound-1 (or any 64-bit value if bound is 0), from the
+      // random bits r, or 0 in generation 0.
+      inline uint64_t Choose(std::size_t generation, uint64_t r, uint64_t bound)
+      {
+        uint64_t v = generation == 0 ? 0 : (bound == 0 ? r : r % bound);
+        ChoiceSequence* c = ChoiceSequence::Active();
+        if (c == nullptr) return v;
+        v = c->Draw(v);
+        return bound == 0 ? v : v % bound;
+      }
+
+      template <typename G>
+      using output_t = typename G::output_type;
+    }
+
+    //------------------------------------------------------------------------------
+    // Any<T>(): a T from Arbitrary<T>.
+    template <typename T>
+    struct AnyGen
+    {
+      using output_type = T;
+
+      T generate(std::size_t generation, unsigned long int randomSeed) const
+      { return Arbitrary<T>::generate(generation, randomSeed); }
+
+      T generate_n(std::size_t n, unsigned long int randomSeed) const
+      { return Arbitrary<T>::generate_n(n, randomSeed); }
+
+      std::vector<T> shrink(const T& t) const
+      { return Arbitrary<T>::shrink(t); }
+    };
+
+    template <typename T>
+    inline AnyGen<T> Any() { return AnyGen<T>{}; }
+
+    //------------------------------------------------------------------------------
+    // InRange(lo, hi): an arithmetic value from lo to hi inclusive (for
+    // floating point, from lo up to hi). Shrinks towards lo.
+    template <typename T>
+    struct InRangeGen
+    {
+      static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value,
+                    "InRange needs an arithmetic type");
+      using output_type = T;
+
+      T m_lo;
+      T m_hi;
+
+      T generate(std::size_t generation, unsigned long int randomSeed) const
+      {
+        return Pick(generation, randomSeed, std::is_integral<T>{});
+      }
+
+      T generate_n(std::size_t n, unsigned long int randomSeed) const
+      {
+        return generate(n, randomSeed);
+      }
+
+      std::vector<T> shrink(const T& t) const
+      {
+        std::vector<T> v;
+        if (t == m_lo) return v;
+        v.push_back(m_lo);
+        T half = Midway(t, std::is_integral<T>{});
+        if (half != m_lo && half != t) v.push_back(half);
+        return v;
+      }
+
+    private:
+      T Midway(T t, std::true_type) const
+      {
+        using U = std::make_unsigned_t<T>;
+        U d = static_cast<U>(static_cast<U>(t) - static_cast<U>(m_lo));
+        return static_cast<T>(static_cast<U>(static_cast<U>(m_lo) + static_cast<U>(d / 2)));
+      }
+
+      T Midway(T t, std::false_type) const
+      {
+        return static_cast<T>(m_lo + (t - m_lo) / 2);
+      }
+
+      T Pick(std::size_t generation, unsigned long int randomSeed, std::true_type) const
+      {
+        using U = std::make_unsigned_t<T>;
+        // the span wraps to 0 for the whole range of a 64-bit type
+        uint64_t bound = static_cast<uint64_t>(static_cast<U>(m_hi) - static_cast<U>(m_lo)) + 1;
+        uint64_t c = detail::Choose(generation, SplitMix64::Mix(randomSeed), bound);
+        return static_cast<T>(static_cast<U>(static_cast<U>(m_lo) + static_cast<U>(c)));
+      }
+
+      T Pick(std::size_t generation, unsigned long int randomSeed, std::false_type) const
+      {
+        const uint64_t bound = uint64_t{1} << std::numeric_limits<double>::digits;
+        uint64_t c = detail::Choose(generation, SplitMix64::Mix(randomSeed), bound);
+        double unit = static_cast<double>(c) / static_cast<double>(bound);
+        return static_cast<T>(static_cast<double>(m_lo)
+                              + unit * (static_cast<double>(m_hi) - static_cast<double>(m_lo)));
+      }
+    };
+
+    template <typename T>
+    inline InRangeGen<T> InRange(T lo, T hi) { return InRangeGen<T>{lo, hi}; }
+
+    //------------------------------------------------------------------------------
+    // ElementOf(a, b, ...): one of the given values. Shrinks towards the first.
+    template <typename T, std::size_t N>
+    struct ElementOfGen
+    {
+      static_assert(N > 0, "ElementOf needs at least one value");
+      using output_type = T;
+
+      std::array<T, N> m_elements;
+
+      T generate(std::size_t generation, unsigned long int randomSeed) const
+      {
+        return m_elements[static_cast<std::size_t>(
+            detail::Choose(generation, SplitMix64::Mix(randomSeed), N))];
+      }
+
+      T generate_n(std::size_t n, unsigned long int randomSeed) const
+      {
+        return generate(n, randomSeed);
+      }
+
+      std::vector<T> shrink(const T& t) const
+      {
+        std::vector<T> v;
+        for (std::size_t i = 0; i < N && !(m_elements[i] == t); ++i)
+        {
+          v.push_back(m_elements[i]);
+        }
+        return v;
+      }
+    };
+
+    template <typename T, typename... Ts>
+    inline ElementOfGen<T, sizeof...(Ts) + 1> ElementOf(T t, Ts... ts)
+    {
+      return ElementOfGen<T, sizeof...(Ts) + 1>{{{std::move(t), T(std::move(ts))...}}};
+    }
+
+    //------------------------------------------------------------------------------
+    // Map(g, f): f of a value from g.
+    template <typename G, typename F>
+    struct MapGen
+    {
+      using output_type = std::decay_t<decltype(std::declval<const F&>()(
+          std::declval<detail::output_t<G>>()))>;
+
+      G m_g;
+      F m_f;
+
+      output_type generate(std::size_t generation, unsigned long int randomSeed) const
+      { return m_f(m_g.generate(generation, randomSeed)); }
+
+      output_type generate_n(std::size_t n, unsigned long int randomSeed) const
+      { return m_f(m_g.generate_n(n, randomSeed)); }
+
+      std::vector<output_type> shrink(const output_type&) const
+      { return std::vector<output_type>{}; }
+    };
+
+    template <typename G, typename F>
+    inline MapGen<G, F> Map(G g, F f) { return MapGen<G, F>{std::move(g), std::move(f)}; }
+
+    //------------------------------------------------------------------------------
+    // Filter(g, p): a value from g for which p holds. Values are generated
+    // until one does, at most MAX_TRIES times, so p should hold often; after
+    // that the last value is given whether or not p holds.
+    template <typename G, typename P>
+    struct FilterGen
+    {
+      using output_type = detail::output_t<G>;
+      static const std::size_t MAX_TRIES = 100;
+
+      G m_g;
+      P m_p;
+
+      output_type generate(std::size_t generation, unsigned long int randomSeed) const
+      {
+        SplitMix64 r(randomSeed);
+        output_type t = m_g.generate(generation, r.Split());
+        for (std::size_t i = 1; i < MAX_TRIES && !m_p(t); ++i)
+        {
+          t = m_g.generate(generation, r.Split());
+        }
+        return t;
+      }
+
+      output_type generate_n(std::size_t n, unsigned long int randomSeed) const
+      {
+        SplitMix64 r(randomSeed);
+        output_type t = m_g.generate_n(n, r.Split());
+        for (std::size_t i = 1; i < MAX_TRIES && !m_p(t); ++i)
+        {
+          t = m_g.generate_n(n, r.Split());
+        }
+        return t;
+      }
+
+      std::vector<output_type> shrink(const output_type& t) const
+      {
+        std::vector<output_type> v;
+        for (auto& s : m_g.shrink(t))
+        {
+          if (m_p(s)) v.push_back(std::move(s));
+        }
+        return v;
+      }
+    };
+
+    template <typename G, typename P>
+    inline FilterGen<G, P> Filter(G g, P p) { return FilterGen<G, P>{std::move(g), std::move(p)}; }
+
+    //------------------------------------------------------------------------------
+    // Bind(g, f): a value from the generator f returns for a value from g.
+    template <typename G, typename F>
+    struct BindGen
+    {
+      using next_type = std::decay_t<decltype(std::declval<const F&>()(
+          std::declval<detail::output_t<G>>()))>;
+      using output_type = detail::output_t<next_type>;
+
+      G m_g;
+      F m_f;
+
+      output_type generate(std::size_t generation, unsigned long int randomSeed) const
+      {
+        SplitMix64 r(randomSeed);
+        auto a = m_g.generate(generation, r.Split());
+        return m_f(std::move(a)).generate(generation, r.Split());
+      }
+
+      output_type generate_n(std::size_t n, unsigned long int randomSeed) const
+      {
+        SplitMix64 r(randomSeed);
+        auto a = m_g.generate_n(n, r.Split());
+        return m_f(std::move(a)).generate_n(n, r.Split());
+      }
+
+      std::vector<output_type> shrink(const output_type&) const
+      { return std::vector<output_type>{}; }
+    };
+
+    template <typename G, typename F>
+    inline BindGen<G, F> Bind(G g, F f) { return BindGen<G, F>{std::move(g), std::move(f)}; }
+
+    //------------------------------------------------------------------------------
+    namespace detail
+    {
+      // Calls the i'th generator's generate (or generate_n, with n as the
+      // generation); unrolled at compile time into a chain of comparisons.
+      template <std::size_t I, typename Tuple>
+      inline output_t<std::tuple_element_t<0, Tuple>> GenerateAt(
+          const Tuple& gs, std::size_t i, bool exact, std::size_t generation,
+          unsigned long int randomSeed, std::true_type /*last*/)
+      {
+        (void)i;
+        return exact
+          ? std::get<I>(gs).generate_n(generation, randomSeed)
+          : std::get<I>(gs).generate(generation, randomSeed);
+      }
+
+      template <std::size_t I, typename Tuple>
+      inline output_t<std::tuple_element_t<0, Tuple>> GenerateAt(
+          const Tuple& gs, std::size_t i, bool exact, std::size_t generation,
+          unsigned long int randomSeed, std::false_type /*last*/)
+      {
+        if (i == I)
+        {
+          return exact
+            ? std::get<I>(gs).generate_n(generation, randomSeed)
+            : std::get<I>(gs).generate(generation, randomSeed);
+        }
+        return GenerateAt<I + 1>(
+            gs, i, exact, generation, randomSeed,
+            std::integral_constant<bool, I + 2 == std::tuple_size<Tuple>::value>{});
+      }
+
+      template <typename Tuple>
+      inline output_t<std::tuple_element_t<0, Tuple>> GenerateAt(
+          const Tuple& gs, std::size_t i, bool exact, std::size_t generation,
+          unsigned long int randomSeed)
+      {
+        return GenerateAt<0>(
+            gs, i, exact, generation, randomSeed,
+            std::integral_constant<bool, std::tuple_size<Tuple>::value == 1>{});
+      }
+    }
+
+    //------------------------------------------------------------------------------
+    // OneOf(g1, g2, ...): a value from one of the generators, chosen uniformly.
+    // The generators should all have the same output_type.
+    template <typename... Gs>
+    struct OneOfGen
+    {
+      static_assert(sizeof...(Gs) > 0, "OneOf needs at least one generator");
+      using output_type = detail::output_t<std::tuple_element_t<0, std::tuple<Gs...>>>;
+
+      std::tuple<Gs...> m_gs;
+
+      output_type generate(std::size_t generation, unsigned long int randomSeed) const
+      { return Generate(false, generation, randomSeed); }
+
+      output_type generate_n(std::size_t n, unsigned long int randomSeed) const
+      { return Generate(true, n, randomSeed); }
+
+      std::vector<output_type> shrink(const output_type&) const
+      { return std::vector<output_type>{}; }
+
+    private:
+      output_type Generate(bool exact, std::size_t generation, unsigned long int randomSeed) const
+      {
+        SplitMix64 r(randomSeed);
+        auto i = static_cast<std::size_t>(
+            detail::Choose(generation, r.Split(), sizeof...(Gs)));
+        return detail::GenerateAt(m_gs, i, exact, generation, r.Split());
+      }
+    };
+
+    template <typename... Gs>
+    inline OneOfGen<Gs...> OneOf(Gs... gs) { return OneOfGen<Gs...>{std::make_tuple(std::move(gs)...)}; }
+
+    //------------------------------------------------------------------------------
+    // Frequency(Weighted(w1, g1), Weighted(w2, g2), ...): a value from one of
+    // the generators, chosen with probability in proportion to its weight.
+    template <typename G>
+    struct WeightedGen
+    {
+      std::size_t m_weight;
+      G m_g;
+    };
+
+    template <typename G>
+    inline WeightedGen<G> Weighted(std::size_t weight, G g) { return WeightedGen<G>{weight, std::move(g)}; }
+
+    template <typename... Gs>
+    struct FrequencyGen
+    {
+      static_assert(sizeof...(Gs) > 0, "Frequency needs at least one generator");
+      using output_type = detail::output_t<std::tuple_element_t<0, std::tuple<Gs...>>>;
+
+      std::array<std::size_t, sizeof...(Gs)> m_weights;
+      std::tuple<Gs...> m_gs;
+
+      output_type generate(std::size_t generation, unsigned long int randomSeed) const
+      { return Generate(false, generation, randomSeed); }
+
+      output_type generate_n(std::size_t n, unsigned long int randomSeed) const
+      { return Generate(true, n, randomSeed); }
+
+      std::vector<output_type> shrink(const output_type&) const
+      { return std::vector<output_type>{}; }
+
+    private:
+      output_type Generate(bool exact, std::size_t generation, unsigned long int randomSeed) const
+      {
+        SplitMix64 r(randomSeed);
+        uint64_t total = 0;
+        for (auto w : m_weights) total += w;
+        uint64_t c = detail::Choose(generation, r.Split(), total);
+        std::size_t i = 0;
+        while (i + 1 < sizeof...(Gs) && c >= m_weights[i])
+        {
+          c -= m_weights[i++];
+        }
+        return detail::GenerateAt(m_gs, i, exact, generation, r.Split());
+      }
+    };
+
+    template <typename... Gs>
+    inline FrequencyGen<Gs...> Frequency(WeightedGen<Gs>... ws)
+    {
+      return FrequencyGen<Gs...>{{{ws.m_weight...}}, std::make_tuple(std::move(ws.m_g)...)};
+    }
+  }
+
+  //------------------------------------------------------------------------------
+  // An Arbitrary made from a generator: the specialization derives from
+  // ArbitraryFromGenerator<itself> and supplies the generator.
+  //
+  //   template <>
+  //   struct Arbitrary<Point> : public ArbitraryFromGenerator<Arbitrary<Point>>
+  //   {
+  //     static auto generator() { return gen::Map(...); }
+  //   };
+  template <typename Derived>
+  struct ArbitraryFromGenerator
+  {
+    static auto generate(std::size_t generation, unsigned long int randomSeed)
+    { return Derived::generator().generate(generation, randomSeed); }
+
+    static auto generate_n(std::size_t n, unsigned long int randomSeed)
+    { return Derived::generator().generate_n(n, randomSeed); }
+
+    template <typename T>
+    static std::vector<T> shrink(const T& t)
+    { return Derived::generator().shrink(t); }
+  };
+}
@@ -0,0 +1,257 @@
+// Copyright (c) 2014-2016 Ben Deane
+// This code is distributed under the MIT license. See LICENSE for details.
+
+#pragma once
+
+#include "cancellation.h"
+#include "output.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#ifndef _WIN32
+#define TESTINATOR_ISOLATION_SUPPORTED
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace testinator
+{
+#ifdef TESTINATOR_ISOLATION_SUPPORTED
+  namespace isolation
+  {
+    //------------------------------------------------------------------------------
+    // Messages sent from a worker process back to the runner: the outputter
+    // calls made while running a test, then the test's result.
+    enum MessageKind : uint8_t
+    {
+      MSG_SKIP_TEST,
+      MSG_START_TEST,
+      MSG_DIAGNOSTIC,
+      MSG_END_TEST,
+      MSG_ABORT,
+      MSG_RESULT
+    };
+
+    // Flags in the m_n field of a MSG_RESULT.
+    enum ResultFlags : uint64_t
+    {
+      RESULT_SUCCESS = 1 << 0,
+      RESULT_ABORT = 1 << 1,
+    };
+
+    struct Message
+    {
+      MessageKind m_kind;
+      uint64_t m_n;
+      std::string m_s1;
+      std::string m_s2;
+    };
+
+    //------------------------------------------------------------------------------
+    inline bool WriteAll(int fd, const char* buf, std::size_t len)
+    {
+      while (len > 0)
+      {
+        auto n = write(fd, buf, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        buf += n;
+        len -= static_cast<std::size_t>(n);
+      }
+      return true;
+    }
+
+    inline bool ReadAll(int fd, char* buf, std::size_t len)
+    {
+      while (len > 0)
+      {
+        auto n = read(fd, buf, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        buf += n;
+        len -= static_cast<std::size_t>(n);
+      }
+      return true;
+    }
+
+    template <typename T>
+    inline void Append(std::string& buf, const T& t)
+    {
+      buf.append(reinterpret_cast<const char*>(&t), sizeof(T));
+    }
+
+    template <typename T>
+    inline bool Read(int fd, T& t)
+    {
+      return ReadAll(fd, reinterpret_cast<char*>(&t), sizeof(T));
+    }
+
+    inline bool ReadString(int fd, std::string& s)
+    {
+      uint64_t len;
+      if (!Read(fd, len)) return false;
+      s.resize(static_cast<std::size_t>(len));
+      return len == 0 || ReadAll(fd, &s[0], s.size());
+    }
+
+    // A message is written with a single write so that a reader only sees a
+    // partial one if the writer died.
+    inline bool WriteMessage(int fd, const Message& m)
+    {
+      std::string buf;
+      Append(buf, static_cast<uint8_t>(m.m_kind));
+      Append(buf, m.m_n);
+      Append(buf, static_cast<uint64_t>(m.m_s1.size()));
+      buf.append(m.m_s1);
+      Append(buf, static_cast<uint64_t>(m.m_s2.size()));
+      buf.append(m.m_s2);
+      return WriteAll(fd, buf.data(), buf.size());
+    }
+
+    inline bool ReadMessage(int fd, Message& m)
+    {
+      uint8_t kind;
+      if (!Read(fd, kind) || kind > MSG_RESULT) return false;
+      m.m_kind = static_cast<MessageKind>(kind);
+      return Read(fd, m.m_n) && ReadString(fd, m.m_s1) && ReadString(fd, m.m_s2);
+    }
+
+    //------------------------------------------------------------------------------
+    // Forwards a worker's outputter calls to the runner as they happen, so that
+    // if the worker crashes, the output up to the crash is not lost.
+    struct PipeOutputter : public Outputter
+    {
+      PipeOutputter(int fd) : m_fd(fd) {}
+
+      virtual void skipTest(const std::string& name, const std::string& msg) const override
+      {
+        WriteMessage(m_fd, {MSG_SKIP_TEST, 0, name, msg});
+      }
+
+      virtual void startTest(const std::string& name) const override
+      {
+        WriteMessage(m_fd, {MSG_START_TEST, 0, name, std::string()});
+      }
+
+      virtual void diagnostic(const std::string& msg) const override
+      {
+        WriteMessage(m_fd, {MSG_DIAGNOSTIC, 0, std::string(), msg});
+      }
+
+      virtual void endTest(const std::string& name, bool success) const override
+      {
+        WriteMessage(m_fd, {MSG_END_TEST, success ? 1u : 0u, name, std::string()});
+      }
+
+      virtual void abort(const std::string& msg) const override
+      {
+        WriteMessage(m_fd, {MSG_ABORT, 0, std::string(), msg});
+      }
+
+    private:
+      int m_fd;
+    };
+
+    // Replays a worker's message to an outputter; returns false for a result
+    // message, which is not an outputter call.
+    inline bool Forward(const Message& m, const Outputter* op)
+    {
+      switch (m.m_kind)
+      {
+        case MSG_SKIP_TEST: op->skipTest(m.m_s1, m.m_s2); return true;
+        case MSG_START_TEST: op->startTest(m.m_s1); return true;
+        case MSG_DIAGNOSTIC: op->diagnostic(m.m_s2); return true;
+        case MSG_END_TEST: op->endTest(m.m_s1, m.m_n != 0); return true;
+        case MSG_ABORT: op->abort(m.m_s2); return true;
+        case MSG_RESULT: return false;
+        default: return false;
+      }
+    }
+
+    //------------------------------------------------------------------------------
+    inline std::string DescribeExit(int status)
+    {
+      if (WIFSIGNALED(status))
+      {
+        int sig = WTERMSIG(status);
+        return "killed by signal " + std::to_string(sig)
+          + " (" + strsignal(sig) + ")";
+      }
+      if (WIFEXITED(status))
+      {
+        return "exited with status " + std::to_string(WEXITSTATUS(status));
+      }
+      return "stopped";
+    }
+
+    //------------------------------------------------------------------------------
+    // While the runner talks to its workers, a write to a dead worker should
+    // fail rather than kill the runner.
+    class IgnoreSigpipe
+    {
+    public:
+      IgnoreSigpipe()
+      {
+        struct sigaction ignore;
+        std::memset(&ignore, 0, sizeof(ignore));
+        ignore.sa_handler = SIG_IGN;
+        sigaction(SIGPIPE, &ignore, &m_previous);
+      }
+
+      ~IgnoreSigpipe()
+      {
+        sigaction(SIGPIPE, &m_previous, nullptr);
+      }
+
+    private:
+      struct sigaction m_previous;
+    };
+
+    //------------------------------------------------------------------------------
+    // While tests run in workers, SIGUSR1 cancels the run. The runner sends it
+    // to the workers when one of them cancels (since forked workers inherit
+    // the handler, it is installed before they are started).
+    inline CancellationToken*& SignalledToken()
+    {
+      static CancellationToken* s_token = nullptr;
+      return s_token;
+    }
+
+    inline void OnCancelSignal(int)
+    {
+      if (CancellationToken* t = SignalledToken()) t->Cancel();
+    }
+
+    class CancelOnSignal
+    {
+    public:
+      CancelOnSignal(CancellationToken& token)
+        : m_previousToken(SignalledToken())
+      {
+        SignalledToken() = &token;
+        struct sigaction cancel;
+        std::memset(&cancel, 0, sizeof(cancel));
+        cancel.sa_handler = OnCancelSignal;
+        sigaction(SIGUSR1, &cancel, &m_previous);
+      }
+
+      ~CancelOnSignal()
+      {
+        sigaction(SIGUSR1, &m_previous, nullptr);
+        SignalledToken() = m_previousToken;
+      }
+
+    private:
+      CancellationToken* m_previousToken;
+      struct sigaction m_previous;
+    };
+  }
+#endif
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2014-2016 Ben Deane
+// This code is distributed under the MIT license. See LICENSE for details.
+
+#pragma once
+
+#include "duration_history.h"
+#include "test.h"
+
+#include <cstdio>
+#include <ostream>
+#include <string>
+
+namespace testinator
+{
+  //------------------------------------------------------------------------------
+  inline std::string JSONEscape(const std::string& s)
+  {
+    std::string ret;
+    ret.reserve(s.size());
+    for (char c : s)
+    {
+      switch (c)
+      {
+        case '"': ret += "\\\""; break;
+        case '\\': ret += "\\\\"; break;
+        case '\n': ret += "\\n"; break;
+        case '\t': ret += "\\t"; break;
+        default:
+          if (static_cast<unsigned char>(c) < 0x20)
+          {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned int>(c));
+            ret += buf;
+          }
+          else
+          {
+            ret += c;
+          }
+          break;
+      }
+    }
+    return ret;
+  }
+
+  //------------------------------------------------------------------------------
+  // Lists the registered tests. The "json" format is an object with a "tests"
+  // array with one test per line, giving suite, name, type (TEST, PROPERTY,
+  // TIMED_TEST or COMPLEXITY_PROPERTY) and expected cost in nanoseconds (from
+  // the duration history in params, or 0 without one). Any other format lists
+  // one test per line as SUITE.NAME.
+  inline void ListTests(std::ostream& os, const std::string& format,
+                        const RunParams& params)
+  {
+    std::vector<const Test*> tests = GetTestRegistry().GetTests();
+
+    if (format != "json")
+    {
+      for (auto t : tests)
+      {
+        os << t->GetSuiteName() << '.' << t->GetName() << '\n';
+      }
+      return;
+    }
+
+    DurationHistory history;
+    if (!params.m_historyFile.empty()) history.Load(params.m_historyFile);
+    auto unknownCost = history.Mean();
+
+    os << "{\"tests\": [";
+    const char* sep = "\n";
+    for (auto t : tests)
+    {
+      auto cost = unknownCost;
+      history.Lookup(t->GetSuiteName(), t->GetName(), cost);
+      os << sep
+         << "{\"suite\": \"" << JSONEscape(t->GetSuiteName())
+         << "\", \"name\": \"" << JSONEscape(t->GetName())
+         << "\", \"type\": \"" << t->GetType()
+         << "\", \"cost\": " << cost.count() << '}';
+      sep = ",\n";
+    }
+    os << "\n]}\n";
+  }
+}
@@ -10,8 +10,13 @@ namespace testinator
     std::string outputterName;
     std::string testName;
     std::string suiteName;
+    std::string filter;
     testinator::RunParams p;
     auto oflags = testinator::OF_COLOR|testinator::OF_QUIET_SUCCESS;
+    std::size_t numRepeats = 0;
+    bool untilFail = false;
+    bool listTests = false;
+    std::string listFormat;
 
     for (int i = 1; i < argc; ++i)
     {
@@ -44,6 +49,15 @@ namespace testinator
         }
       }
 
+      {
+        std::string option = "--filter=";
+        if (s.compare(0, option.size(), option) == 0)
+        {
+          filter = s.substr(option.size());
+          continue;
+        }
+      }
+
       {
         std::string option = "--numChecks=";
         if (s.compare(0, option.size(), option) == 0)
@@ -64,6 +78,160 @@ namespace testinator
         }
       }
 
+      {
+        std::string option = "--jobs=";
+        if (s.compare(0, option.size(), option) == 0)
+        {
+          char* end;
+          p.m_numJobs = strtoul(s.substr(option.size()).c_str(), &end, 10);
+          continue;
+        }
+      }
+
+      {
+        std::string option = "--checkThreads=";
+        if (s.compare(0, option.size(), option) == 0)
+        {
+          char* end;
+          p.m_numCheckThreads = strtoul(s.substr(option.size()).c_str(), &end, 10);
+          continue;
+        }
+      }
+
+      {
+        std::string option = "--shrinkSteps=";
+        if (s.compare(0, option.size(), option) == 0)
+        {
+          char* end;
+          p.m_shrinkParams.m_maxSteps = strtoul(s.substr(option.size()).c_str(), &end, 10);
+          continue;
+        }
+      }
+
+      {
+        std::string option = "--shrinkTime=";
+        if (s.compare(0, option.size(), option) == 0)
+        {
+          char* end;
+          p.m_shrinkParams.m_maxTime = std::chrono::milliseconds(
+              strtoul(s.substr(option.size()).c_str(), &end, 10));
+          continue;
+        }
+      }
+
+      {
+        std::string option = "--maxSize=";
+        if (s.compare(0, option.size(), option) == 0)
+        {
+          char* end;
+          p.m_maxSize = strtoul(s.substr(option.size()).c_str(), &end, 10);
+          continue;
+        }
+      }
+
+      {
+        std::string option = "--shrinkChoices";
+        if (s.compare(0, option.size(), option) == 0)
+        {
+          p.m_shrinkParams.m_useChoices = true;
+          continue;
+        }
+      }
+
+      {
+        std::string option = "--guided";
+        if (s.compare(0, option.size(), option) == 0)
+        {
+          p.m_guided = true;
+          continue;
+        }
+      }
+
+      {
+        std::string option = "--arena";
+        if (s.compare(0, option.size(), option) == 0)
+        {
+          p.m_arena = true;
+          continue;
+        }
+      }
+
+      {
+        std::string option = "--examples=";
+        if (s.compare(0, option.size(), option) == 0)
+        {
+          p.m_exampleDirectory = s.substr(option.size());
+          continue;
+        }
+      }
+
+      {
+        std::string option = "--history=";
+        if (s.compare(0, option.size(), option) == 0)
+        {
+          p.m_historyFile = s.substr(option.size());
+          continue;
+        }
+      }
+
+      {
+        std::string option = "--shard=";
+        if (s.compare(0, option.size(), option) == 0)
+        {
+          char* end;
+          p.m_shardIndex = strtoul(s.substr(option.size()).c_str(), &end, 10);
+          if (*end == '/')
+            p.m_shardCount = strtoul(end + 1, &end, 10);
+          if (*end != 0 || p.m_shardCount == 0 || p.m_shardIndex >= p.m_shardCount)
+          {
+            std::cerr << "Invalid shard: " << s << std::endl;
+            return 1;
+          }
+          continue;
+        }
+      }
+
+      {
+        std::string option = "--timeout=";
+        if (s.compare(0, option.size(), option) == 0)
+        {
+          char* end;
+          p.m_timeout = std::chrono::milliseconds(
+              strtoul(s.substr(option.size()).c_str(), &end, 10));
+          continue;
+        }
+      }
+
+      {
+        std::string option = "--repeat=";
+        if (s.compare(0, option.size(), option) == 0)
+        {
+          char* end;
+          numRepeats = strtoul(s.substr(option.size()).c_str(), &end, 10);
+          continue;
+        }
+      }
+
+      {
+        std::string option = "--until-fail";
+        if (s.compare(0, option.size(), option) == 0)
+        {
+          untilFail = true;
+          continue;
+        }
+      }
+
+      {
+        std::string option = "--list-tests";
+        if (s.compare(0, option.size(), option) == 0)
+        {
+          listTests = true;
+          if (s.size() > option.size() && s[option.size()] == '=')
+            listFormat = s.substr(option.size() + 1);
+          continue;
+        }
+      }
+
       {
         std::string option = "--alpha";
         if (s.compare(0, option.size(), option) == 0)
@@ -73,6 +241,24 @@ namespace testinator
         }
       }
 
+      {
+        std::string option = "--isolate";
+        if (s.compare(0, option.size(), option) == 0)
+        {
+          p.m_flags |= testinator::RF_ISOLATE;
+          continue;
+        }
+      }
+
+      {
+        std::string option = "--fail-fast";
+        if (s.compare(0, option.size(), option) == 0)
+        {
+          p.m_flags |= testinator::RF_FAIL_FAST;
+          continue;
+        }
+      }
+
       {
         std::string option = "--verbose";
         if (s.compare(0, option.size(), option) == 0)
@@ -102,29 +288,76 @@ namespace testinator
                     << std::endl
                     << "--testName=NAME    run only the named test" << std::endl
                     << "--suiteName=NAME   run only the tests in the named suite" << std::endl
+                    << "--filter=PATTERNS  run only tests matching PATTERNS, e.g. Suite.*:*Foo*-*Slow"
+                    << std::endl
                     << "--alpha            run tests in alphabetical order" << std::endl
                     << "--output=FORMAT    use the specified output formatter, e.g. TAP" << std::endl
                     << "--verbose          give verbose output (according to formatter)" << std::endl
                     << "--nocolor          output without ANSI color codes (according to formatter)"
                     << std::endl
                     << "--numChecks=N      number of checks to use for property tests" << std::endl
-                    << "--seed=SEED        use SEED for property test randomization" << std::endl;
+                    << "--checkThreads=N   spread property checks over N threads (0 for one per core)"
+                    << std::endl
+                    << "--maxSize=N        generate containers of up to N elements (default 100)"
+                    << std::endl
+                    << "--seed=SEED        use SEED for property test randomization" << std::endl
+                    << "--shrinkSteps=N    shrink a failing value at most N steps (default 1000)"
+                    << std::endl
+                    << "--shrinkTime=MS    spend at most MS shrinking a failing value" << std::endl
+                    << "--shrinkChoices    shrink the random choices behind a failing value"
+                    << std::endl
+                    << "--guided           guide property checks by coverage (see coverage.h)"
+                    << std::endl
+                    << "--arena            allocate pmr property arguments from a per-check arena"
+                    << std::endl
+                    << "--examples=DIR     store failing property examples in DIR; replay them first"
+                    << std::endl
+                    << "--jobs=N           run tests on N threads (0 for one per core)" << std::endl
+                    << "--history=FILE     record test durations in FILE; run longest first" << std::endl
+                    << "--shard=I/N        run only shard I (from 0) of N disjoint shards" << std::endl
+                    << "--isolate          run tests in worker processes (--jobs of them)" << std::endl
+                    << "--fail-fast        stop all tests at the first failure" << std::endl
+                    << "--timeout=MS       fail (and stop) any test that runs longer than MS" << std::endl
+                    << "--repeat=N         run the tests N times, each with its own seed" << std::endl
+                    << "--until-fail       repeat the tests until they fail (at most --repeat times)"
+                    << std::endl
+                    << "--list-tests[=json] list the registered tests instead of running them"
+                    << std::endl;
           return 0;
         }
       }
 
     }
 
+    if (listTests)
+    {
+      testinator::ListTests(std::cout, listFormat, p);
+      return 0;
+    }
+
     std::unique_ptr<testinator::Outputter> op = testinator::MakeOutputter(
         outputterName, static_cast<testinator::OutputFlags>(oflags));
 
     testinator::Results rs;
-    if (!testName.empty())
-      rs = testinator::RunTest(testName, p, op.get());
-    else if (!suiteName.empty())
-      rs = testinator::RunSuite(suiteName, p, op.get());
+    auto run = [&] (const testinator::RunParams& params,
+                    const testinator::Outputter* o) {
+      if (!filter.empty())
+        return testinator::RunFiltered(testinator::TestFilter(filter), params, o);
+      else if (!testName.empty() && !suiteName.empty())
+        return testinator::RunFiltered(
+            testinator::TestFilter::Exact(suiteName, testName), params, o);
+      else if (!testName.empty())
+        return testinator::RunTest(testName, params, o);
+      else if (!suiteName.empty())
+        return testinator::RunSuite(suiteName, params, o);
+      else
+        return testinator::RunAllTests(params, o);
+    };
+
+    if (numRepeats > 1 || untilFail)
+      rs = testinator::RunRepeatedly(run, p, numRepeats, untilFail, op.get());
     else
-      rs = testinator::RunAllTests(p, op.get());
+      rs = run(p, op.get());
 
     auto numPassed = count_if(rs.cbegin(), rs.cend(),
                               [] (const testinator::Result& r) { return r.m_success; });
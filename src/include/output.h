@@ -6,7 +6,9 @@
 #include <cstddef>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 namespace testinator
 {
@@ -96,6 +98,7 @@ namespace testinator
   {
     TAPOutputter(std::ostream& os = std::cout)
       : m_os(os)
+      , m_numTests(0)
     {}
 
     virtual void startRun(std::size_t numTests) const override
@@ -147,6 +150,151 @@ namespace testinator
 #undef GREEN
 #undef NORMAL
 
+  //------------------------------------------------------------------------------
+  // Records the calls made on it so that they can be replayed to another
+  // outputter later. Used to keep the output of each test contiguous when tests
+  // run concurrently.
+  struct BufferedOutputter : public Outputter
+  {
+    virtual void startRun(std::size_t numTests) const override
+    {
+      m_events.push_back({Event::START_RUN, std::string(), std::string(), numTests, 0});
+    }
+
+    virtual void skipTest(const std::string& name, const std::string& msg) const override
+    {
+      m_events.push_back({Event::SKIP_TEST, name, msg, 0, 0});
+    }
+
+    virtual void startTest(const std::string& name) const override
+    {
+      m_events.push_back({Event::START_TEST, name, std::string(), 0, 0});
+    }
+
+    virtual void diagnostic(const std::string& msg) const override
+    {
+      m_events.push_back({Event::DIAGNOSTIC, std::string(), msg, 0, 0});
+    }
+
+    virtual void endTest(const std::string& name, bool success) const override
+    {
+      m_events.push_back({Event::END_TEST, name, std::string(), success ? 1u : 0u, 0});
+    }
+
+    virtual void abort(const std::string& msg) const override
+    {
+      m_events.push_back({Event::ABORT, std::string(), msg, 0, 0});
+    }
+
+    virtual void endRun(std::size_t numTests, std::size_t numSuccesses) const override
+    {
+      m_events.push_back({Event::END_RUN, std::string(), std::string(),
+                          numTests, numSuccesses});
+    }
+
+    void replay(const Outputter* op) const
+    {
+      for (const auto& e : m_events)
+      {
+        switch (e.m_kind)
+        {
+          case Event::START_RUN: op->startRun(e.m_n1); break;
+          case Event::SKIP_TEST: op->skipTest(e.m_name, e.m_msg); break;
+          case Event::START_TEST: op->startTest(e.m_name); break;
+          case Event::DIAGNOSTIC: op->diagnostic(e.m_msg); break;
+          case Event::END_TEST: op->endTest(e.m_name, e.m_n1 != 0); break;
+          case Event::ABORT: op->abort(e.m_msg); break;
+          case Event::END_RUN: op->endRun(e.m_n1, e.m_n2); break;
+          default: break;
+        }
+      }
+    }
+
+    void clear() { m_events.clear(); }
+    bool empty() const { return m_events.empty(); }
+
+  private:
+    struct Event
+    {
+      enum Kind
+      {
+        START_RUN,
+        SKIP_TEST,
+        START_TEST,
+        DIAGNOSTIC,
+        END_TEST,
+        ABORT,
+        END_RUN
+      };
+
+      Kind m_kind;
+      std::string m_name;
+      std::string m_msg;
+      std::size_t m_n1;
+      std::size_t m_n2;
+    };
+
+    mutable std::vector<Event> m_events;
+  };
+
+  //------------------------------------------------------------------------------
+  // Forwards each call to another outputter while holding a mutex, so that
+  // another thread can write to that outputter too.
+  struct LockedOutputter : public Outputter
+  {
+    LockedOutputter(const Outputter* op, std::mutex& m)
+      : m_op(op)
+      , m_mutex(m)
+    {
+    }
+
+    virtual void startRun(std::size_t numTests) const override
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_op->startRun(numTests);
+    }
+
+    virtual void skipTest(const std::string& name, const std::string& msg) const override
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_op->skipTest(name, msg);
+    }
+
+    virtual void startTest(const std::string& name) const override
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_op->startTest(name);
+    }
+
+    virtual void diagnostic(const std::string& msg) const override
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_op->diagnostic(msg);
+    }
+
+    virtual void endTest(const std::string& name, bool success) const override
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_op->endTest(name, success);
+    }
+
+    virtual void abort(const std::string& msg) const override
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_op->abort(msg);
+    }
+
+    virtual void endRun(std::size_t numTests, std::size_t numSuccesses) const override
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_op->endRun(numTests, numSuccesses);
+    }
+
+  private:
+    const Outputter* m_op;
+    std::mutex& m_mutex;
+  };
+
   //------------------------------------------------------------------------------
   inline std::unique_ptr<Outputter> MakeOutputter(
       const std::string& name,
@@ -4,23 +4,60 @@
 #pragma once
 
 #include "arbitrary.h"
+#include "choice.h"
+#include "coverage.h"
+#include "digest.h"
+#include "example_database.h"
 #include "function_traits.h"
 #include "prettyprint.h"
+#include "rng.h"
 #include "test.h"
 #include "test_macros.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <cstddef>
 #include <iterator>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <random>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <type_traits>
 #include <vector>
 
 namespace testinator
 {
 
+  //------------------------------------------------------------------------------
+  // How a property's checks are run.
+  struct CheckParams
+  {
+    // The checks are spread over this many threads (0 for one per hardware
+    // thread); each check's case depends only on the seed and its index, so
+    // the failure reported is the same whatever the number of threads. The
+    // threads all call the same property object.
+    std::size_t m_numThreads = 1;
+    // A failing value is shrunk within this budget.
+    ShrinkParams m_shrinkParams;
+    // The size of generated containers ramps up from 0 for the first check to
+    // this for the last (see GenerationSize).
+    std::size_t m_maxSize = 100;
+    // The failing cases stored in this file (see example_database.h) are
+    // checked first, and a failure is stored in it; empty for none.
+    std::string m_examplesFile;
+    // Cases are guided by edge coverage, where the code is instrumented (see
+    // coverage.h); the checks then run on one thread.
+    bool m_guided = false;
+    // Each check's pmr arguments are allocated from an arena that is released
+    // after the check (see GenerationResource); needs C++17.
+    bool m_arena = false;
+  };
+
   //------------------------------------------------------------------------------
   class Property
   {
@@ -31,9 +68,20 @@ namespace testinator
     {
     }
 
-    bool check(std::size_t N, const Outputter* outputter)
+    // Checks f itself rather than a copy (e.g. a PropertyTest, whose EXPECTs
+    // must reach the test).
+    template <typename F>
+    Property(std::reference_wrapper<F> f)
+      : m_internal(std::make_unique<Internal<F, F&>>(f.get()))
+    {
+    }
+
+    // Stops early (without failing) if the token is cancelled.
+    bool check(std::size_t N, const Outputter* outputter,
+               const CancellationToken* token = nullptr,
+               const CheckParams& params = CheckParams())
     {
-      return m_internal->check(N, outputter);
+      return m_internal->check(N, outputter, token, params);
     }
 
   private:
@@ -41,62 +89,473 @@ namespace testinator
     {
       virtual ~InternalBase() {}
       virtual bool check(std::size_t N,
-                         const Outputter*) = 0;
+                         const Outputter*,
+                         const CancellationToken*,
+                         const CheckParams&) = 0;
     };
 
-    template <typename U>
+    // The property is held as S: a copy of U, or a reference to one.
+    template <typename U, typename S = U>
     struct Internal : public InternalBase
     {
       using argTuple = typename function_traits<U>::argTuple;
 
-      Internal(const U& u) : m_u(u) {}
+      // Checks are claimed by threads in batches of this many.
+      static const std::size_t BATCH = 8;
 
-      virtual bool check(std::size_t N, const Outputter* op)
+      template <typename V>
+      Internal(V&& u) : m_u(std::forward<V>(u)) {}
+
+      virtual bool check(std::size_t N, const Outputter* op,
+                         const CancellationToken* token, const CheckParams& params)
       {
-        auto seed = m_u.m_randomSeed;
-        for (std::size_t i = 0; i < N; ++i)
+        m_token = token;
+        m_numChecks = N;
+        m_maxSize = params.m_maxSize;
+        const ShrinkParams& shrinkParams = params.m_shrinkParams;
+        const std::string& examplesFile = params.m_examplesFile;
+
+        // Stored examples are replayed before anything is generated; those
+        // that now pass are dropped, and those after a failing one are kept.
+        // The file is only rewritten once every example has been replayed
+        // and, if none fails, every check has passed: a cancelled run leaves
+        // it as it was.
+        std::vector<Example> examples;
+        if (!examplesFile.empty()) examples = LoadExamples(examplesFile);
+        bool storedFails = false;
+        auto stored = examples.begin();
+        for (; stored != examples.end() && !cancelled(); ++stored)
         {
-          auto t = Arbitrary<argTuple>::generate(i, seed);
-          if (!checkSingle(std::move(t), op))
+          if (fails(replay(*stored)))
           {
-            op->diagnostic(
-                Diagnostic(Cons<Nil>()
-                           << "Reproduce failure with --seed=" << m_u.m_randomSeed));
-            return false;
+            storedFails = true;
+            break;
           }
-          seed = GetTestRegistry().RNG()();
         }
-        return true;
+        if (!storedFails && stored != examples.end()) return true;
+
+        Example failure;
+        std::string reproduce;
+        if (storedFails)
+        {
+          failure = *stored;
+          examples.erase(examples.begin(), stored + 1);
+          op->diagnostic(
+              Diagnostic(Cons<Nil>()
+                         << "Stored example (check " << failure.m_check
+                         << ", seed " << failure.m_seed << ") still fails"));
+        }
+        else if (params.m_guided && CoverageMap::Instrumented())
+        {
+          examples.clear();
+          std::size_t i = guidedFailure(N, failure);
+          if (i == N)
+          {
+            if (!examplesFile.empty() && !cancelled()) save(examplesFile, examples, op);
+            return true;
+          }
+          reproduce = Diagnostic(Cons<Nil>()
+                                 << "Reproduce failure (check " << i << ") with --seed="
+                                 << m_u.m_randomSeed << " --guided");
+        }
+        else
+        {
+          examples.clear();
+          std::size_t i = firstFailure(N, params.m_numThreads, params.m_arena);
+          if (i == N)
+          {
+            // other threads may have seen the cancellation; poll it on this one
+            // so that the test is reported as cancelled
+            if (!cancelled() && !examplesFile.empty()) save(examplesFile, examples, op);
+            return true;
+          }
+          // only the failing case's choices are needed, so only it records them
+          failure = exampleFor(i);
+          ChoiceSequence record;
+          generateCase(i, &record);
+          failure.m_choices = record.Choices();
+        }
+        if (reproduce.empty())
+        {
+          reproduce = Diagnostic(Cons<Nil>()
+                                 << "Reproduce failure (check " << failure.m_check
+                                 << ") with --seed=" << failure.m_seed);
+        }
+
+        // With choices, the stored example is the shrunk one. Otherwise a
+        // shrunk value has no choices to regenerate it from, so the stored
+        // example is the unminimized one that failed (which shrinks the same
+        // way next time), and is described as it replays.
+        argTuple t = shrinkParams.m_useChoices
+          ? shrinkChoices(failure, op, shrinkParams)
+          : shrink(replay(failure), op, shrinkParams);
+        op->diagnostic(reproduce);
+
+        if (!examplesFile.empty())
+        {
+          std::ostringstream description;
+          if (shrinkParams.m_useChoices)
+            description << prettyprint(t);
+          else
+            description << prettyprint(replay(failure));
+          failure.m_description = description.str();
+          examples.insert(examples.begin(), failure);
+          save(examplesFile, examples, op);
+        }
+        return false;
+      }
+
+      bool fails(const argTuple& t) { return !function_traits<U>::apply(m_u, t); }
+
+      // Check i of N is generated at size i * (maxSize + 1) / N, so the sizes
+      // are spread evenly from 0 to maxSize.
+      Example exampleFor(std::size_t i) const
+      {
+        Example e;
+        e.m_seed = m_u.m_randomSeed;
+        e.m_check = i;
+        e.m_size = std::min(m_maxSize, i * (m_maxSize + 1) / m_numChecks);
+        return e;
+      }
+
+      // Generates the case for check i; with a choice sequence, generates it
+      // from choices, recording them.
+      argTuple generateCase(std::size_t i, ChoiceSequence* record = nullptr) const
+      {
+        if (record == nullptr) return generateArgs(exampleFor(i));
+
+        record->Clear();
+        ChoiceSequence::Scope scope(*record);
+        return generateArgs(exampleFor(i));
+      }
+
+      // Generates the case for check i into t, which is kept between checks
+      // so that its storage is reused (see Arbitrary<T>::regenerate).
+      // Recorded choices must replay the same way through generate, so this
+      // is only for checks that don't record them: generate's order of pair
+      // and tuple elements is up to the compiler.
+      const argTuple& regenerateCase(std::size_t i, std::unique_ptr<argTuple>& t) const
+      {
+        return regenerateCase(i, t, std::is_move_assignable<argTuple>{});
+      }
+
+      const argTuple& regenerateCase(std::size_t i, std::unique_ptr<argTuple>& t,
+                                     std::true_type) const
+      {
+        Example e = exampleFor(i);
+        if (t == nullptr)
+        {
+          t = std::make_unique<argTuple>(generateArgs(e));
+          return *t;
+        }
+        GenerationSize::Scope size(e.m_size);
+        Regenerate(*t, e.m_check, SplitMix64::Stream(e.m_seed, e.m_check));
+        return *t;
       }
 
-      bool checkSingle(argTuple&& t, const Outputter* op)
+      // arguments that can't be assigned are generated afresh
+      const argTuple& regenerateCase(std::size_t i, std::unique_ptr<argTuple>& t,
+                                     std::false_type) const
       {
-        bool result = function_traits<U>::apply(m_u, t);
-        if (result) return true;
+        t = std::make_unique<argTuple>(generateCase(i));
+        return *t;
+      }
 
+      static argTuple generateArgs(const Example& e)
+      {
+        GenerationSize::Scope size(e.m_size);
+        return Arbitrary<argTuple>::generate(
+            e.m_check, SplitMix64::Stream(e.m_seed, e.m_check));
+      }
+
+      // Regenerates an example from the given choices (by default, its own);
+      // used receives the choices read.
+      static argTuple replay(const Example& e, const std::vector<uint64_t>& choices,
+                             std::vector<uint64_t>* used = nullptr)
+      {
+        ChoiceSequence r(choices);
+        ChoiceSequence::Scope scope(r);
+        argTuple t = generateArgs(e);
+        if (used != nullptr) *used = r.Choices();
+        return t;
+      }
+
+      static argTuple replay(const Example& e) { return replay(e, e.m_choices); }
+
+      static void save(const std::string& examplesFile,
+                       const std::vector<Example>& examples, const Outputter* op)
+      {
+        if (!SaveExamples(examplesFile, examples))
+        {
+          op->diagnostic("Could not write examples to " + examplesFile);
+        }
+      }
+
+      // Returns the index of the first of checks [0, N) that fails, or N. Threads
+      // claim batches of checks in order and stop claiming once they are past
+      // the earliest failure found so far; every earlier check has then been
+      // claimed and will be finished, so the result does not depend on timing.
+      // Every thread calls m_u, so it must be safe to call concurrently (see
+      // PropertyTest::CheckProperty).
+      std::size_t firstFailure(std::size_t N, std::size_t numThreads, bool arena)
+      {
+        if (numThreads == 0) numThreads = std::thread::hardware_concurrency();
+        numThreads = std::max<std::size_t>(1, std::min(numThreads, (N + BATCH - 1) / BATCH));
+
+        std::atomic<std::size_t> next{0};
+        std::atomic<std::size_t> first{N};
+        auto worker = [&] () {
+          std::unique_ptr<argTuple> t;
+#ifdef TESTINATOR_PMR
+          std::unique_ptr<std::pmr::monotonic_buffer_resource> resource;
+          if (arena) resource = std::make_unique<std::pmr::monotonic_buffer_resource>();
+#else
+          static_cast<void>(arena);
+#endif
+          auto passes = [&] (std::size_t i) {
+#ifdef TESTINATOR_PMR
+            if (resource != nullptr)
+            {
+              bool passed;
+              {
+                GenerationResource::Scope scope(resource.get());
+                passed = function_traits<U>::apply(m_u, generateCase(i));
+              }
+              resource->release();
+              return passed;
+            }
+#endif
+            return function_traits<U>::apply(m_u, regenerateCase(i, t));
+          };
+          for (;;)
+          {
+            std::size_t begin = next.fetch_add(BATCH);
+            if (begin >= first.load() || cancelled()) return;
+            std::size_t end = std::min(begin + BATCH, N);
+            for (std::size_t i = begin; i < end; ++i)
+            {
+              if (!passes(i))
+              {
+                std::size_t f = first.load();
+                while (i < f && !first.compare_exchange_weak(f, i)) {}
+                return;
+              }
+            }
+          }
+        };
+
+        std::vector<std::thread> threads;
+        for (std::size_t i = 1; i < numThreads; ++i)
+        {
+          threads.emplace_back(worker);
+        }
+        worker();
+        for (auto& t : threads)
+        {
+          t.join();
+        }
+        return first.load();
+      }
+
+      // Coverage-guided checking: a case that reaches new edges (see
+      // CoverageMap) joins a corpus, and each check either generates a new case
+      // or mutates the choices of one in the corpus (see MutateChoices). The
+      // checks run in order on this thread, drawing their mutations from the
+      // seed, so that a seed reproduces the run. Returns the index of the
+      // failing check, with its example, or N.
+      std::size_t guidedFailure(std::size_t N, Example& failure)
+      {
+        std::vector<Example> corpus;
+        std::vector<uint8_t> seen(CoverageMap::SIZE);
+        for (std::size_t i = 0; i < N && !cancelled(); ++i)
+        {
+          SplitMix64 r(SplitMix64::Stream(~m_u.m_randomSeed, i));
+          Example e;
+          std::vector<uint64_t> used;
+          bool failed;
+          if (corpus.empty() || r() % 4 == 0)
+          {
+            e = exampleFor(i);
+            ChoiceSequence record;
+            argTuple t = generateCase(i, &record);
+            used = record.Choices();
+            CoverageMap::Reset();
+            failed = fails(t);
+          }
+          else
+          {
+            // Later entries reached newer edges, so they are favoured; a mutant
+            // may grow as large as a new case could.
+            auto n = corpus.size();
+            e = corpus[n - 1 - std::min(r() % n, r() % n)];
+            e.m_size = std::max(e.m_size, exampleFor(i).m_size);
+            const Example& other = corpus[r() % n];
+            argTuple t = replay(e, MutateChoices(e.m_choices, other.m_choices, r), &used);
+            CoverageMap::Reset();
+            failed = fails(t);
+          }
+          e.m_choices = std::move(used);
+          if (failed)
+          {
+            failure = std::move(e);
+            return i;
+          }
+          if (CoverageMap::Merge(seen)) corpus.push_back(std::move(e));
+        }
+        return N;
+      }
+
+      using Clock = std::chrono::steady_clock;
+
+      // Greedily shrinks a failing value: each step moves to the first of its
+      // shrink candidates that still fails, until none does or the budget runs
+      // out. Only the final value is reported, with what it took to find it.
+      // Shrinkers often reach the same candidate by different paths; a
+      // candidate already evaluated is skipped, since it is known to pass (or
+      // is a value already shrunk past).
+      argTuple shrink(argTuple&& t, const Outputter* op, const ShrinkParams& shrinkParams)
+      {
+        auto start = Clock::now();
+        std::size_t steps = 0;
+        std::size_t evaluations = 0;
+        std::size_t repeats = 0;
+        const char* stoppedBy = nullptr;
+        SeenSet seen;
+        seen.Insert(t);
+        // A cancelled run doesn't need the smallest counterexample.
+        while (!cancelled())
+        {
+          if (steps == shrinkParams.m_maxSteps)
+          {
+            stoppedBy = "step";
+            break;
+          }
+
+          bool shrunk = false;
+          std::vector<argTuple> v = Arbitrary<argTuple>::shrink(t);
+          for (auto& candidate : v)
+          {
+            if (outOfTime(start, shrinkParams))
+            {
+              stoppedBy = "time";
+              break;
+            }
+            if (!seen.Insert(candidate))
+            {
+              ++repeats;
+              continue;
+            }
+            ++evaluations;
+            if (fails(candidate))
+            {
+              t = std::move(candidate);
+              ++steps;
+              shrunk = true;
+              break;
+            }
+          }
+          if (!shrunk) break;
+        }
+        report(t, op, start, steps, evaluations, repeats, stoppedBy);
+        return std::move(t);
+      }
+
+      // Shrinks a failing example by shrinking the choices it is generated from
+      // (see ChoiceSequence), within the same budget; the example is left with
+      // the shrunk choices. As above, choices already evaluated are skipped.
+      argTuple shrinkChoices(Example& failure, const Outputter* op,
+                             const ShrinkParams& shrinkParams)
+      {
+        auto start = Clock::now();
+        std::vector<uint64_t> choices = failure.m_choices;
+
+        std::size_t evaluations = 0;
+        std::size_t repeats = 0;
+        const char* stoppedBy = nullptr;
+        SeenSet seen;
+        seen.Insert(choices);
+        auto stillFails = [&] (const std::vector<uint64_t>& c,
+                               std::vector<uint64_t>& used) {
+          if (!seen.Insert(c))
+          {
+            ++repeats;
+            return false;
+          }
+          ++evaluations;
+          return fails(replay(failure, c, &used));
+        };
+        auto keepGoing = [&] (std::size_t steps) {
+          if (cancelled()) return false;
+          if (steps == shrinkParams.m_maxSteps) stoppedBy = "step";
+          else if (outOfTime(start, shrinkParams)) stoppedBy = "time";
+          return stoppedBy == nullptr;
+        };
+        std::size_t steps = ShrinkChoices(choices, stillFails, keepGoing);
+        failure.m_choices = choices;
+        argTuple t = replay(failure);
+        report(t, op, start, steps, evaluations, repeats, stoppedBy);
+        return t;
+      }
+
+      static bool outOfTime(Clock::time_point start, const ShrinkParams& shrinkParams)
+      {
+        return shrinkParams.m_maxTime.count() > 0
+          && Clock::now() - start >= shrinkParams.m_maxTime;
+      }
+
+      void report(const argTuple& t, const Outputter* op, Clock::time_point start,
+                  std::size_t steps, std::size_t evaluations, std::size_t repeats,
+                  const char* stoppedBy)
+      {
         op->diagnostic(
             Diagnostic(Cons<Nil>()
                        << "Failed " << prettyprint(t)));
-
-        std::vector<argTuple> v = Arbitrary<argTuple>::shrink(std::move(t));
-
-        if (!v.empty())
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            Clock::now() - start);
+        std::string stats = Diagnostic(
+            Cons<Nil>()
+            << "Shrank in " << steps << " steps ("
+            << evaluations << " evaluations, " << repeats << " repeats skipped, "
+            << ms.count() << "ms)");
+        if (stoppedBy != nullptr)
         {
-          return std::all_of(std::make_move_iterator(v.begin()),
-                             std::make_move_iterator(v.end()),
-                             [this, op] (argTuple&& st)
-                             { return checkSingle(std::move(st), op); })
-            && result;
+          stats += std::string("; stopped at the ") + stoppedBy + " limit";
         }
-        return false;
+        op->diagnostic(stats);
       }
 
-      U m_u;
+      bool cancelled() const { return m_token != nullptr && m_token->Poll(); }
+
+      S m_u;
+      const CancellationToken* m_token = nullptr;
+      std::size_t m_numChecks = 1;
+      std::size_t m_maxSize = 0;
     };
 
     std::unique_ptr<InternalBase> m_internal;
   };
 
+  //------------------------------------------------------------------------------
+  // Checks property f on one case decoded from bytes (see ChoicesFromBytes),
+  // which the Arbitrary generators read as their choices, with containers of
+  // up to maxSize elements. This is how a fuzzer's input becomes a property's
+  // arguments (see fuzz.h): f is called in place, with no Property made. A
+  // failing case is printed to failure, if given.
+  template <typename F>
+  inline bool CheckBytes(F& f, const uint8_t* data, std::size_t size,
+                         std::size_t maxSize = 100, std::ostream* failure = nullptr)
+  {
+    using argTuple = typename function_traits<F>::argTuple;
+    ChoiceSequence choices(ChoicesFromBytes(data, size));
+    ChoiceSequence::Scope scope(choices);
+    GenerationSize::Scope generationSize(maxSize);
+    // (generation 0 is the simplest case, ignoring the choices)
+    argTuple t = Arbitrary<argTuple>::generate(1, 0);
+    if (function_traits<F>::apply(f, t)) return true;
+    if (failure != nullptr) *failure << prettyprint(t);
+    return false;
+  }
+
   //------------------------------------------------------------------------------
   class PropertyTest : public Test
   {
@@ -111,6 +570,17 @@ namespace testinator
     virtual bool Setup(const RunParams& params) override
     {
       m_numChecks = params.m_numPropertyChecks;
+      m_checkParams.m_numThreads = params.m_numCheckThreads;
+      m_checkParams.m_shrinkParams = params.m_shrinkParams;
+      m_checkParams.m_maxSize = params.m_maxSize;
+      m_checkParams.m_examplesFile.clear();
+      if (!params.m_exampleDirectory.empty())
+      {
+        m_checkParams.m_examplesFile = ExampleFile(params.m_exampleDirectory,
+                                                   GetSuiteName(), GetName());
+      }
+      m_checkParams.m_guided = params.m_guided;
+      m_checkParams.m_arena = params.m_arena;
       m_randomSeed = params.m_randomSeed;
       if (m_randomSeed == 0)
       {
@@ -121,7 +591,41 @@ namespace testinator
       return true;
     }
 
+    virtual const char* GetType() const override { return "PROPERTY"; }
+
+    // Checks f, this test's own property. On more than one thread the checks
+    // call f concurrently, so it must only compute its result: what it writes
+    // (with EXPECT or DIAGNOSTIC) is held back under a lock, and fails the
+    // test.
+    template <typename F>
+    bool CheckProperty(F& f)
+    {
+      Property p(std::ref(f));
+      if (m_checkParams.m_numThreads == 1)
+        return p.check(m_numChecks, m_op, &Cancellation(), m_checkParams);
+
+      const Outputter* op = m_op;
+      BufferedOutputter held;
+      std::mutex mutex;
+      LockedOutputter locked(&held, mutex);
+      m_op = &locked;
+      bool passed = p.check(m_numChecks, op, &Cancellation(), m_checkParams);
+      m_op = op;
+      if (held.empty()) return passed;
+      held.replay(op);
+      op->diagnostic("A property checked on more than one thread must not write"
+                     " output (or EXPECT); use --checkThreads=1");
+      return false;
+    }
+
+    // Checks the property on the case decoded from bytes (see CheckBytes).
+    virtual bool CheckBytes(const uint8_t*, std::size_t, std::ostream* = nullptr)
+    {
+      return true;
+    }
+
     size_t m_numChecks = 1;
+    CheckParams m_checkParams;
     unsigned long m_randomSeed = 0;
   };
 }
@@ -135,8 +639,14 @@ namespace testinator
       : testinator::PropertyTest(#NAME "Property", #SUITE) {}   \
     virtual bool Run() override                                 \
     {                                                           \
-      testinator::Property p(*this);                            \
-      return p.check(m_numChecks, m_op);                        \
+      return CheckProperty(*this);                              \
+    }                                                           \
+    virtual bool CheckBytes(const uint8_t* data,                \
+                            std::size_t size,                   \
+                            std::ostream* failure) override     \
+    {                                                           \
+      return testinator::CheckBytes(                            \
+          *this, data, size, m_checkParams.m_maxSize, failure); \
     }                                                           \
     bool operator()(__VA_ARGS__);                               \
   } s_##SUITE##NAME##_Property;                                 \
@@ -0,0 +1,183 @@
+// Copyright (c) 2014-2016 Ben Deane
+// This code is distributed under the MIT license. See LICENSE for details.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#define TESTINATOR_RNG_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace testinator
+{
+  //------------------------------------------------------------------------------
+  // A SplitMix64 generator: the state is a single 64-bit counter, advanced by a
+  // fixed odd increment and scrambled on output. Seeding one is just storing the
+  // seed, so Arbitrary makes a fresh generator from its randomSeed for every
+  // value it generates; that keeps generation deterministic per seed without
+  // sharing generator state between values or threads.
+  //
+  // Split() returns the seed of a new, independent stream (this generator's
+  // next output); containers use it to give each element its own stream.
+  class SplitMix64
+  {
+  public:
+    using result_type = uint64_t;
+
+    explicit SplitMix64(uint64_t seed = 0) : m_state(seed) {}
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT64_MAX; }
+
+    result_type operator()()
+    {
+      m_state += GAMMA;
+      return Mix(m_state);
+    }
+
+    unsigned long Split() { return static_cast<unsigned long>(operator()()); }
+
+    // The seed returned by the (i+1)'th Split() of a generator with the given
+    // seed, without stepping through the first i.
+    static unsigned long Stream(unsigned long seed, std::size_t i)
+    {
+      return static_cast<unsigned long>(
+          Mix(static_cast<uint64_t>(seed) + (i + 1) * GAMMA));
+    }
+
+    static uint64_t Mix(uint64_t z)
+    {
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+      return z ^ (z >> 31);
+    }
+
+  private:
+    static constexpr uint64_t GAMMA = 0x9e3779b97f4a7c15ull;
+
+    uint64_t m_state;
+  };
+
+  //------------------------------------------------------------------------------
+  // Four xoshiro256** generators run in lockstep, for filling large buffers.
+  // The lanes are seeded from a SplitMix64 and their outputs interleaved, so
+  // Generate() writes lane 0, 1, 2, 3, lane 0, ... With AVX2 a step of all
+  // four lanes is one register's worth of work, with SSE2 two; otherwise the
+  // lanes are stepped one at a time. The output is the same in every case, so
+  // a seed reproduces the same values on any machine.
+  class Xoshiro256x4
+  {
+  public:
+    static const std::size_t LANES = 4;
+
+    explicit Xoshiro256x4(uint64_t seed)
+    {
+      SplitMix64 seeder(seed);
+      for (auto& word : m_s)
+      {
+        for (auto& lane : word)
+        {
+          lane = seeder();
+        }
+      }
+    }
+
+    // Writes numSteps * LANES values to out.
+    void Generate(uint64_t* out, std::size_t numSteps)
+    {
+#if defined(__AVX2__)
+      __m256i s0 = Load(m_s[0]);
+      __m256i s1 = Load(m_s[1]);
+      __m256i s2 = Load(m_s[2]);
+      __m256i s3 = Load(m_s[3]);
+      for (std::size_t i = 0; i < numSteps; ++i, out += LANES)
+      {
+        // rotl(s1 * 5, 7) * 9, with the multiplies as shifts and adds
+        __m256i x = _mm256_add_epi64(_mm256_slli_epi64(s1, 2), s1);
+        x = _mm256_or_si256(_mm256_slli_epi64(x, 7), _mm256_srli_epi64(x, 57));
+        x = _mm256_add_epi64(_mm256_slli_epi64(x, 3), x);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), x);
+
+        __m256i t = _mm256_slli_epi64(s1, 17);
+        s2 = _mm256_xor_si256(s2, s0);
+        s3 = _mm256_xor_si256(s3, s1);
+        s1 = _mm256_xor_si256(s1, s2);
+        s0 = _mm256_xor_si256(s0, s3);
+        s2 = _mm256_xor_si256(s2, t);
+        s3 = _mm256_or_si256(_mm256_slli_epi64(s3, 45), _mm256_srli_epi64(s3, 19));
+      }
+      Store(m_s[0], s0);
+      Store(m_s[1], s1);
+      Store(m_s[2], s2);
+      Store(m_s[3], s3);
+#elif defined(TESTINATOR_RNG_SSE2)
+      for (std::size_t half = 0; half < LANES; half += 2)
+      {
+        __m128i s0 = Load(&m_s[0][half]);
+        __m128i s1 = Load(&m_s[1][half]);
+        __m128i s2 = Load(&m_s[2][half]);
+        __m128i s3 = Load(&m_s[3][half]);
+        for (std::size_t i = 0; i < numSteps; ++i)
+        {
+          __m128i x = _mm_add_epi64(_mm_slli_epi64(s1, 2), s1);
+          x = _mm_or_si128(_mm_slli_epi64(x, 7), _mm_srli_epi64(x, 57));
+          x = _mm_add_epi64(_mm_slli_epi64(x, 3), x);
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * LANES + half), x);
+
+          __m128i t = _mm_slli_epi64(s1, 17);
+          s2 = _mm_xor_si128(s2, s0);
+          s3 = _mm_xor_si128(s3, s1);
+          s1 = _mm_xor_si128(s1, s2);
+          s0 = _mm_xor_si128(s0, s3);
+          s2 = _mm_xor_si128(s2, t);
+          s3 = _mm_or_si128(_mm_slli_epi64(s3, 45), _mm_srli_epi64(s3, 19));
+        }
+        Store(&m_s[0][half], s0);
+        Store(&m_s[1][half], s1);
+        Store(&m_s[2][half], s2);
+        Store(&m_s[3][half], s3);
+      }
+#else
+      for (std::size_t i = 0; i < numSteps; ++i, out += LANES)
+      {
+        for (std::size_t l = 0; l < LANES; ++l)
+        {
+          out[l] = Rotl(m_s[1][l] * 5, 7) * 9;
+
+          uint64_t t = m_s[1][l] << 17;
+          m_s[2][l] ^= m_s[0][l];
+          m_s[3][l] ^= m_s[1][l];
+          m_s[1][l] ^= m_s[2][l];
+          m_s[0][l] ^= m_s[3][l];
+          m_s[2][l] ^= t;
+          m_s[3][l] = Rotl(m_s[3][l], 45);
+        }
+      }
+#endif
+    }
+
+  private:
+#if defined(__AVX2__)
+    static __m256i Load(const uint64_t* p)
+    { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+    static void Store(uint64_t* p, __m256i x)
+    { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), x); }
+#elif defined(TESTINATOR_RNG_SSE2)
+    static __m128i Load(const uint64_t* p)
+    { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+    static void Store(uint64_t* p, __m128i x)
+    { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), x); }
+#else
+    static uint64_t Rotl(uint64_t x, int k)
+    { return (x << k) | (x >> (64 - k)); }
+#endif
+
+    // m_s[word][lane]
+    uint64_t m_s[4][LANES];
+  };
+}
@@ -3,9 +3,17 @@
 
 #pragma once
 
+#include "cancellation.h"
 #include "output.h"
+#include "rng.h"
+#include "test_macros.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iterator>
 #include <memory>
+#include <random>
 #include <string>
 #include <vector>
 
@@ -19,6 +27,27 @@ namespace testinator
     // ALPHA_ORDER means run tests in alphabetical order (default is random
     // order).
     RF_ALPHA_ORDER = 1 << 0,
+
+    // ISOLATE means run each test in a worker process, so that a test that
+    // crashes fails without taking down the run.
+    RF_ISOLATE = 1 << 1,
+
+    // FAIL_FAST means cancel the run at the first failure, stopping the tests
+    // in flight as well as those not yet started.
+    RF_FAIL_FAST = 1 << 2,
+  };
+
+  //------------------------------------------------------------------------------
+  // How to shrink a failing property's counterexample. The limits are on the
+  // number of shrink steps taken (each to a smaller failing value), and the
+  // time spent (0 for no limit). With m_useChoices, values are generated from
+  // a recorded sequence of choices and shrunk by shrinking that sequence (see
+  // choice.h) instead of with Arbitrary::shrink.
+  struct ShrinkParams
+  {
+    size_t m_maxSteps = 1000;
+    std::chrono::milliseconds m_maxTime{0};
+    bool m_useChoices = false;
   };
 
   //------------------------------------------------------------------------------
@@ -26,7 +55,35 @@ namespace testinator
   {
     uint32_t m_flags = RF_NONE;
     size_t m_numPropertyChecks = 100;
+    // Number of threads each property's checks are spread over; 0 means one
+    // per hardware thread.
+    size_t m_numCheckThreads = 1;
+    ShrinkParams m_shrinkParams;
+    // The largest size of generated containers; sizes ramp up to it over a
+    // property's checks.
+    size_t m_maxSize = 100;
+    // Directory of failing property examples (see example_database.h), which
+    // are replayed before new cases are generated; empty for none.
+    std::string m_exampleDirectory;
+    // Guide property checks by edge coverage (see coverage.h).
+    bool m_guided = false;
+    // Allocate each property check's pmr arguments from an arena (see
+    // arbitrary_pmr.h).
+    bool m_arena = false;
     unsigned long m_randomSeed = 0;
+    // Number of worker threads to run tests on; 0 means one per hardware
+    // thread.
+    size_t m_numJobs = 1;
+    // File of per-test durations used to schedule the longest tests first;
+    // updated at the end of each run.
+    std::string m_historyFile;
+    // Run only shard m_shardIndex (counting from 0) of m_shardCount: a
+    // deterministic, disjoint slice of the tests.
+    size_t m_shardIndex = 0;
+    size_t m_shardCount = 1;
+    // Time allowed for each test (0 for no limit), unless the test sets its
+    // own (see DEF_TEST_TIMEOUT).
+    std::chrono::milliseconds m_timeout{0};
   };
 
   //------------------------------------------------------------------------------
@@ -35,6 +92,7 @@ namespace testinator
     std::string m_suiteName;
     std::string m_testName;
     bool m_success;
+    std::chrono::nanoseconds m_duration{0};
   };
 
   using Results = std::vector<Result>;
@@ -52,6 +110,15 @@ namespace testinator
 
     virtual bool Setup(const RunParams&) { return true; }
     virtual bool Run() { return true; }
+    // The kind of test, named after the macro that defines it.
+    virtual const char* GetType() const { return "TEST"; }
+    // Whether the test must run with no other test alongside it: tests that
+    // measure time are, since concurrent tests would skew their timings.
+    virtual bool IsExclusive() const { return false; }
+    // The time this test is allowed, overriding RunParams::m_timeout; 0 means
+    // use that.
+    virtual std::chrono::milliseconds GetTimeout() const
+    { return std::chrono::milliseconds(0); }
     bool RunWithBranches();
 
     Result RunWrapper(const Outputter* outputter)
@@ -63,14 +130,25 @@ namespace testinator
     }
 
     const std::string& GetName() const { return m_name; }
+    const std::string& GetSuiteName() const { return m_suiteName; }
     bool skipped() const { return m_skipped; }
 
+    // The token that cancels the run this test is part of (by ABORT, or by a
+    // failure with RF_FAIL_FAST). Long-running loops poll it to stop early.
+    const CancellationToken& Cancellation() const;
+    bool CancellationRequested() const { return Cancellation().Poll(); }
+
   protected:
     bool m_success = true;
     bool m_skipped = false;
     const std::string m_name;
+    const std::string m_suiteName;
     TestRegistry& m_registry;
     const Outputter* m_op;
+
+  private:
+    friend class TestRegistry;
+    std::size_t m_registryIndex = 0;
   };
 }
 
@@ -85,6 +163,19 @@ namespace testinator
   } s_##SUITE##NAME##_Test;                               \
   bool SUITE##NAME::Run()
 
+//------------------------------------------------------------------------------
+#define DEF_TEST_TIMEOUT(NAME, SUITE, MILLISECONDS)       \
+  class SUITE##NAME : public testinator::Test             \
+  {                                                       \
+  public:                                                 \
+    SUITE##NAME()                                         \
+      : testinator::Test(#NAME, #SUITE) {}                \
+    virtual bool Run() override;                          \
+    virtual std::chrono::milliseconds GetTimeout() const override \
+    { return std::chrono::milliseconds(MILLISECONDS); }   \
+  } s_##SUITE##NAME##_Test;                               \
+  bool SUITE##NAME::Run()
+
 //------------------------------------------------------------------------------
 #include "branch.h"
 #include "test_registry.h"
@@ -112,12 +203,145 @@ namespace testinator
     return GetTestRegistry().RunTest(testName, params, outputter);
   }
 
+  inline Results RunFiltered(const TestFilter& filter,
+                             const RunParams& params = RunParams(),
+                             const Outputter* outputter = nullptr)
+  {
+    return GetTestRegistry().RunFiltered(filter, params, outputter);
+  }
+
+  //------------------------------------------------------------------------------
+  // The seed for repetition i of a run with the given base seed (a SplitMix64
+  // stream, so nearby indexes give unrelated seeds). Never 0, which would mean
+  // "choose a random seed".
+  inline unsigned long DeriveSeed(unsigned long baseSeed, std::size_t i)
+  {
+    auto seed = SplitMix64::Stream(baseSeed, i);
+    return seed != 0 ? seed : 1;
+  }
+
+  // Passes on the output of each repetition of a run, but reports all the
+  // repetitions as one run: the plan is given once, up front if the number of
+  // repetitions is known (planRepeats) or at the end if not, and the totals
+  // are given at the end.
+  struct RepeatedOutputter : public Outputter
+  {
+    RepeatedOutputter(const Outputter* op, std::size_t planRepeats)
+      : m_op(op)
+      , m_planRepeats(planRepeats)
+    {
+    }
+
+    virtual void startRun(std::size_t numTests) const override
+    {
+      if (m_planRepeats > 0 && !m_planned) m_op->startRun(numTests * m_planRepeats);
+      m_planned = m_planRepeats > 0;
+    }
+
+    virtual void skipTest(const std::string& name, const std::string& msg) const override
+    {
+      m_op->skipTest(name, msg);
+    }
+
+    virtual void startTest(const std::string& name) const override
+    {
+      m_op->startTest(name);
+    }
+
+    virtual void diagnostic(const std::string& msg) const override
+    {
+      m_op->diagnostic(msg);
+    }
+
+    virtual void endTest(const std::string& name, bool success) const override
+    {
+      m_op->endTest(name, success);
+    }
+
+    virtual void abort(const std::string& msg) const override
+    {
+      m_op->abort(msg);
+    }
+
+    virtual void endRun(std::size_t numTests, std::size_t numSuccesses) const override
+    {
+      m_numTests += numTests;
+      m_numSuccesses += numSuccesses;
+    }
+
+    void finish() const
+    {
+      if (!m_planned) m_op->startRun(m_numTests);
+      m_op->endRun(m_numTests, m_numSuccesses);
+    }
+
+  private:
+    const Outputter* m_op;
+    std::size_t m_planRepeats;
+    mutable bool m_planned = false;
+    mutable std::size_t m_numTests = 0;
+    mutable std::size_t m_numSuccesses = 0;
+  };
+
+  // Runs tests repeatedly in one process: run(params, outputter) runs the
+  // selected tests once (e.g. RunAllTests). There are at most numRepeats
+  // repetitions (0 for no limit), and with untilFail they stop after the first
+  // that fails, and only the last repetition's results are kept. Each
+  // repetition's seed is derived from params.m_randomSeed and logged, so that
+  // a failing repetition can be replayed alone with --seed.
+  template <typename F>
+  inline Results RunRepeatedly(F run, RunParams params,
+                               std::size_t numRepeats, bool untilFail,
+                               const Outputter* outputter = nullptr)
+  {
+    std::unique_ptr<Outputter> nullOutputter;
+    if (outputter == nullptr)
+    {
+      nullOutputter = std::make_unique<Outputter>();
+      outputter = nullOutputter.get();
+    }
+    // Until it fails, a run's length isn't known in advance.
+    RepeatedOutputter op(outputter, untilFail ? 0 : numRepeats);
+
+    auto baseSeed = params.m_randomSeed;
+    if (baseSeed == 0)
+    {
+      std::random_device rd;
+      baseSeed = rd();
+    }
+
+    Results rs;
+    for (std::size_t i = 0; numRepeats == 0 || i < numRepeats; ++i)
+    {
+      params.m_randomSeed = DeriveSeed(baseSeed, i);
+      op.diagnostic(
+          Diagnostic(Cons<Nil>()
+                     << "Repetition " << i + 1 << ": reproduce with --seed="
+                     << params.m_randomSeed));
+      Results r = run(params, &op);
+      if (untilFail)
+      {
+        bool failed = std::any_of(r.cbegin(), r.cend(),
+                                  [] (const Result& res) { return !res.m_success; });
+        rs = std::move(r);
+        if (failed) break;
+      }
+      else
+      {
+        std::move(r.begin(), r.end(), std::back_inserter(rs));
+      }
+    }
+    op.finish();
+    return rs;
+  }
+
   //------------------------------------------------------------------------------
   inline Test::Test(TestRegistry& r, const std::string& n, const std::string& s)
     : m_name(n)
+    , m_suiteName(s)
     , m_registry(r)
   {
-    m_registry.Register(this, n, s);
+    m_registry.Register(this);
   }
 
   inline Test::Test(const std::string& n, const std::string& s)
@@ -129,4 +353,9 @@ namespace testinator
   {
     m_registry.Unregister(this);
   }
+
+  inline const CancellationToken& Test::Cancellation() const
+  {
+    return m_registry.Cancellation();
+  }
 }
@@ -0,0 +1,150 @@
+// Copyright (c) 2014-2016 Ben Deane
+// This code is distributed under the MIT license. See LICENSE for details.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace testinator
+{
+  //------------------------------------------------------------------------------
+  // Glob matching: '*' matches any run of characters, '?' any one character.
+  inline bool GlobMatch(const std::string& pattern, const std::string& s)
+  {
+    std::size_t p = 0;
+    std::size_t i = 0;
+    std::size_t star = std::string::npos;
+    std::size_t starMatch = 0;
+    while (i < s.size())
+    {
+      if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == s[i]))
+      {
+        ++p;
+        ++i;
+      }
+      else if (p < pattern.size() && pattern[p] == '*')
+      {
+        // remember the star and first try matching nothing with it
+        star = p++;
+        starMatch = i;
+      }
+      else if (star != std::string::npos)
+      {
+        // backtrack: let the last star match one more character
+        p = star + 1;
+        i = ++starMatch;
+      }
+      else
+      {
+        return false;
+      }
+    }
+    while (p < pattern.size() && pattern[p] == '*') ++p;
+    return p == pattern.size();
+  }
+
+  //------------------------------------------------------------------------------
+  // A filter expression is a list of patterns separated by ':', optionally
+  // followed by '-' and a list of patterns to exclude. A pattern is SUITE.NAME,
+  // or just NAME to match in any suite, and either part may use wildcards. For
+  // example, "Property.*:*Shrink*-*Slow" selects the tests in suite Property
+  // and tests with Shrink in their names, except those ending in Slow.
+  //
+  // The expression is parsed once; each pattern keeps the literal prefixes of
+  // its suite and name parts so that the registry can find candidate tests in
+  // its sorted indexes instead of matching against every test.
+  class TestFilter
+  {
+  public:
+    struct Pattern
+    {
+      std::string m_suite;
+      std::string m_name;
+      std::string m_suitePrefix;
+      std::string m_namePrefix;
+
+      bool Matches(const std::string& suiteName, const std::string& testName) const
+      {
+        return GlobMatch(m_name, testName) && GlobMatch(m_suite, suiteName);
+      }
+    };
+
+    explicit TestFilter(const std::string& expr)
+    {
+      auto minus = expr.find('-');
+      Parse(expr.substr(0, minus), m_include);
+      if (minus != std::string::npos)
+        Parse(expr.substr(minus + 1), m_exclude);
+      if (m_include.empty())
+        m_include.push_back(MakePattern("*", "*"));
+    }
+
+    // A filter for the one test with the given suite and name.
+    static TestFilter Exact(const std::string& suiteName, const std::string& testName)
+    {
+      TestFilter f;
+      f.m_include.push_back(
+          Pattern{suiteName, testName, suiteName, testName});
+      return f;
+    }
+
+    const std::vector<Pattern>& Included() const { return m_include; }
+
+    bool Excluded(const std::string& suiteName, const std::string& testName) const
+    {
+      for (const auto& p : m_exclude)
+      {
+        if (p.Matches(suiteName, testName)) return true;
+      }
+      return false;
+    }
+
+    bool Matches(const std::string& suiteName, const std::string& testName) const
+    {
+      if (Excluded(suiteName, testName)) return false;
+      for (const auto& p : m_include)
+      {
+        if (p.Matches(suiteName, testName)) return true;
+      }
+      return false;
+    }
+
+  private:
+    TestFilter() = default;
+
+    static std::string LiteralPrefix(const std::string& glob)
+    {
+      return glob.substr(0, glob.find_first_of("*?"));
+    }
+
+    static Pattern MakePattern(const std::string& suite, const std::string& name)
+    {
+      return Pattern{suite, name, LiteralPrefix(suite), LiteralPrefix(name)};
+    }
+
+    static void Parse(const std::string& s, std::vector<Pattern>& patterns)
+    {
+      std::size_t start = 0;
+      while (start <= s.size())
+      {
+        auto end = s.find(':', start);
+        if (end == std::string::npos) end = s.size();
+        std::string p = s.substr(start, end - start);
+        if (!p.empty())
+        {
+          auto dot = p.find('.');
+          if (dot == std::string::npos)
+            patterns.push_back(MakePattern("*", p));
+          else
+            patterns.push_back(MakePattern(p.substr(0, dot), p.substr(dot + 1)));
+        }
+        start = end + 1;
+      }
+    }
+
+    std::vector<Pattern> m_include;
+    std::vector<Pattern> m_exclude;
+  };
+}
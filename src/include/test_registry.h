@@ -3,16 +3,52 @@
 
 #pragma once
 
+#include "duration_history.h"
+#include "isolation.h"
 #include "output.h"
+#include "test_filter.h"
+#include "test_macros.h"
+#include "watchdog.h"
 
 #include <algorithm>
-#include <map>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <mutex>
 #include <random>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 namespace testinator
 {
+  //------------------------------------------------------------------------------
+  // A hash (64-bit FNV-1a) of suite and test name. Unlike std::hash, it is the
+  // same on every platform and in every run, so it can be used to partition
+  // tests between machines.
+  inline uint64_t StableHash(const std::string& suiteName,
+                             const std::string& testName)
+  {
+    uint64_t h = 14695981039346656037ull;
+    auto hashBytes = [&h] (const std::string& s) {
+      for (char c : s)
+      {
+        h ^= static_cast<unsigned char>(c);
+        h *= 1099511628211ull;
+      }
+    };
+    hashBytes(suiteName);
+    h ^= 0xff;
+    h *= 1099511628211ull;
+    hashBytes(testName);
+    return h;
+  }
+
   //------------------------------------------------------------------------------
   class TestRegistry
   {
@@ -24,67 +60,81 @@ namespace testinator
       return s_testRegistry;
     }
 
-    //------------------------------------------------------------------------------
-    void Register(Test* test,
-                  const std::string& testName,
-                  const std::string& suiteName)
+    TestRegistry()
     {
-      m_tests.insert({testName, test});
-      m_testNames.insert({test, testName});
-
-      m_testsBySuite.insert({suiteName, test});
-      m_suiteNames.insert({test, suiteName});
-
       std::random_device rd;
       m_generator.seed(rd());
     }
 
     //------------------------------------------------------------------------------
+    // Registration only appends to a vector (tests may be registered by the
+    // hundred thousand during static initialization); the name and suite
+    // indexes are built on the first lookup after registrations change. The
+    // registry keeps no names of its own: it reads them from each test, which
+    // holds its own copies (since test names may be built at runtime).
+    void Register(Test* test)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      test->m_registryIndex = m_tests.size();
+      m_tests.push_back(test);
+      InvalidateIndexes();
+    }
+
+    //------------------------------------------------------------------------------
+    // Unregistration leaves a hole, and the vector is compacted once it is half
+    // empty, so unregistering every test is linear overall. (Not during a run,
+    // which would move m_firstRunnable.)
     void Unregister(Test* test)
     {
-      const std::string& testName = m_testNames[test];
-      m_tests.erase(testName);
-      m_testNames.erase(test);
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto i = test->m_registryIndex;
+      if (i >= m_tests.size() || m_tests[i] != test) return;
+      m_tests[i] = nullptr;
+      InvalidateIndexes();
 
-      const std::string& suiteName = m_suiteNames[test];
-      auto range = m_testsBySuite.equal_range(suiteName);
-      for (auto& i = range.first; i != range.second; ++i)
+      if (++m_numUnregistered * 2 > m_tests.size() && m_firstRunnable == 0)
       {
-        if (i->second == test)
+        std::size_t n = 0;
+        for (auto t : m_tests)
         {
-          m_testsBySuite.erase(i);
-          break;
+          if (t == nullptr) continue;
+          t->m_registryIndex = n;
+          m_tests[n++] = t;
         }
+        m_tests.resize(n);
+        m_numUnregistered = 0;
       }
-      m_suiteNames.erase(test);
     }
 
     //------------------------------------------------------------------------------
     Results RunAllTests(const RunParams& params = RunParams(),
                         const Outputter* outputter = nullptr)
     {
-      TestMap localMap;
-      localMap.swap(m_tests);
-      Results rs = RunTests(
-          localMap,
+      std::vector<Test*> tests;
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        tests = Runnable(ByName());
+      }
+      return RunTests(
+          tests,
           params,
           outputter != nullptr ? outputter : std::make_unique<Outputter>().get());
-      m_tests.swap(localMap);
-      return rs;
     }
 
     Results RunSuite(const std::string& suiteName,
                      const RunParams& params = RunParams(),
                      const Outputter* outputter = nullptr)
     {
-      TestMap localMap;
-      auto range = m_testsBySuite.equal_range(suiteName);
-      for (auto& i = range.first; i != range.second; ++i)
+      std::vector<Test*> tests;
       {
-        localMap.insert({m_testNames[i->second], i->second});
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto& bySuite = BySuite();
+        auto range = std::equal_range(
+            bySuite.cbegin(), bySuite.cend(), suiteName, CompareSuiteName());
+        tests = Runnable(std::vector<Test*>(range.first, range.second));
       }
       return RunTests(
-          localMap,
+          tests,
           params,
           outputter != nullptr ? outputter : std::make_unique<Outputter>().get());
     }
@@ -93,69 +143,782 @@ namespace testinator
                     const RunParams& params = RunParams(),
                     const Outputter* outputter = nullptr)
     {
-      auto i = m_tests.find(testName);
-      if (i == m_tests.end())
+      std::vector<Test*> tests;
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto& byName = ByName();
+        auto range = std::equal_range(
+            byName.cbegin(), byName.cend(), testName, CompareName());
+        tests = Runnable(std::vector<Test*>(range.first, range.second));
+      }
+      if (tests.empty())
         return std::vector<Result>();
 
-      TestMap localMap;
-      localMap.insert({testName, i->second});
       return RunTests(
-          localMap,
+          tests,
           params,
           outputter != nullptr ? outputter : std::make_unique<Outputter>().get());
     }
 
-    std::mt19937& RNG() { return m_generator; }
-    void Abort() { m_abort = true; }
+    Results RunFiltered(const TestFilter& filter,
+                        const RunParams& params = RunParams(),
+                        const Outputter* outputter = nullptr)
+    {
+      std::vector<Test*> tests;
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        tests = Runnable(Select(filter));
+      }
+      return RunTests(
+          tests,
+          params,
+          outputter != nullptr ? outputter : std::make_unique<Outputter>().get());
+    }
+
+    // All registered tests, in alphabetical order of name.
+    std::vector<const Test*> GetTests()
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      const auto& byName = ByName();
+      return std::vector<const Test*>(byName.cbegin(), byName.cend());
+    }
+
+    // The generator used by properties to pick seeds. It is per-thread so that
+    // tests running on different workers don't share generator state.
+    std::mt19937& RNG()
+    {
+      thread_local std::mt19937 s_generator;
+      return s_generator;
+    }
+
+    void Abort() { m_cancellation.Cancel(); }
+    const CancellationToken& Cancellation() const { return m_cancellation; }
 
   private:
-    // Map of all tests.
-    using TestMap = std::map<std::string, Test*>;
-    // Reverse mapping of tests to test names.
-    using TestNameMap = std::map<Test*, std::string>;
+    // Orderings for the indexes: by name then suite, and by suite then name,
+    // then by order of registration. Each also compares against a bare name
+    // for lookup.
+    struct CompareName
+    {
+      bool operator()(const Test* a, const Test* b) const
+      {
+        int c = a->GetName().compare(b->GetName());
+        if (c == 0) c = a->GetSuiteName().compare(b->GetSuiteName());
+        return c != 0 ? c < 0 : a->m_registryIndex < b->m_registryIndex;
+      }
+      bool operator()(const Test* a, const std::string& b) const { return a->GetName() < b; }
+      bool operator()(const std::string& a, const Test* b) const { return a < b->GetName(); }
+    };
+
+    struct CompareSuiteName
+    {
+      bool operator()(const Test* a, const Test* b) const
+      {
+        int c = a->GetSuiteName().compare(b->GetSuiteName());
+        if (c == 0) c = a->GetName().compare(b->GetName());
+        return c != 0 ? c < 0 : a->m_registryIndex < b->m_registryIndex;
+      }
+      bool operator()(const Test* a, const std::string& b) const { return a->GetSuiteName() < b; }
+      bool operator()(const std::string& a, const Test* b) const { return a < b->GetSuiteName(); }
+    };
+
+    // The indexes; m_mutex must be held.
+    const std::vector<Test*>& ByName()
+    {
+      if (!m_byNameValid)
+      {
+        BuildIndex(m_byName, CompareName());
+        m_byNameValid = true;
+      }
+      return m_byName;
+    }
+
+    const std::vector<Test*>& BySuite()
+    {
+      if (!m_bySuiteValid)
+      {
+        BuildIndex(m_bySuite, CompareSuiteName());
+        m_bySuiteValid = true;
+      }
+      return m_bySuite;
+    }
+
+    template <typename Compare>
+    void BuildIndex(std::vector<Test*>& index, Compare compare) const
+    {
+      index.clear();
+      index.reserve(m_tests.size() - m_numUnregistered);
+      std::copy_if(m_tests.cbegin(), m_tests.cend(), std::back_inserter(index),
+                   [] (const Test* t) { return t != nullptr; });
+      std::stable_sort(index.begin(), index.end(), compare);
+    }
+
+    // The tests matching a filter, in alphabetical order of name. Each pattern
+    // only looks at the tests sharing the longer of its literal suite and name
+    // prefixes, found by binary search in the corresponding index.
+    std::vector<Test*> Select(const TestFilter& filter)
+    {
+      std::vector<Test*> selected;
+      for (const auto& p : filter.Included())
+      {
+        bool bySuite = p.m_suitePrefix.size() > p.m_namePrefix.size();
+        const auto& index = bySuite ? BySuite() : ByName();
+        const auto& prefix = bySuite ? p.m_suitePrefix : p.m_namePrefix;
+        auto key = [bySuite] (const Test* t) -> const std::string& {
+          return bySuite ? t->GetSuiteName() : t->GetName();
+        };
+
+        auto i = std::lower_bound(
+            index.cbegin(), index.cend(), prefix,
+            [&] (const Test* t, const std::string& s) { return key(t) < s; });
+        for (; i != index.cend() && key(*i).compare(0, prefix.size(), prefix) == 0; ++i)
+        {
+          const Test* t = *i;
+          if (p.Matches(t->GetSuiteName(), t->GetName())
+              && !filter.Excluded(t->GetSuiteName(), t->GetName()))
+          {
+            selected.push_back(*i);
+          }
+        }
+      }
+
+      // a test may match several patterns
+      std::sort(selected.begin(), selected.end(), CompareName());
+      selected.erase(std::unique(selected.begin(), selected.end()), selected.end());
+      return selected;
+    }
 
-    // Map of all tests by suite.
-    using TestSuiteMap = std::multimap<std::string, Test*>;
-    // Reverse mapping of tests to suite names.
-    using TestSuiteNameMap = std::map<Test*, std::string>;
+    // A test may itself run tests registered in the same registry; the tests
+    // that were registered when a run started are not run again.
+    std::vector<Test*> Runnable(const std::vector<Test*>& tests) const
+    {
+      if (m_firstRunnable == 0) return tests;
+      std::vector<Test*> runnable;
+      std::copy_if(tests.cbegin(), tests.cend(), std::back_inserter(runnable),
+                   [this] (const Test* t) { return t->m_registryIndex >= m_firstRunnable; });
+      return runnable;
+    }
 
-    Results RunTests(TestMap& m,
+    void InvalidateIndexes()
+    {
+      m_byNameValid = false;
+      m_bySuiteValid = false;
+    }
+
+    // Runs the given tests, which are in alphabetical order of name.
+    Results RunTests(std::vector<Test*> tests,
                      const RunParams& params,
                      const Outputter* outputter)
     {
-      outputter->startRun(m.size());
-      std::size_t numSuccesses = 0;
+      std::size_t previousFirstRunnable;
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        previousFirstRunnable = m_firstRunnable;
+        m_firstRunnable = m_tests.size();
+      }
+      Results rs = RunSchedule(std::move(tests), params, outputter);
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_firstRunnable = previousFirstRunnable;
+      return rs;
+    }
+
+    Results RunSchedule(std::vector<Test*> tests,
+                        const RunParams& params,
+                        const Outputter* outputter)
+    {
+      DurationHistory history;
+      bool useHistory = !params.m_historyFile.empty();
+      if (useHistory) history.Load(params.m_historyFile);
 
-      // Make a vector of test names, shuffle them if necessary.
-      std::vector<const std::string*> testNames;
-      testNames.reserve(m.size());
-      for (auto& i : m)
+      // Keep only this shard's tests, shuffle them if necessary.
+      if (params.m_shardCount > 1)
       {
-        testNames.push_back(&i.first);
+        tests = SelectShard(tests, params, history);
       }
+      auto numTests = tests.size();
+      outputter->startRun(numTests);
+      // With a given seed the order is reproducible too, so that --seed can
+      // replay an order-dependent failure.
       if (!(params.m_flags & RF_ALPHA_ORDER))
       {
-        std::shuffle(testNames.begin(), testNames.end(), m_generator);
+        if (params.m_randomSeed != 0)
+        {
+          std::mt19937 gen(static_cast<std::mt19937::result_type>(params.m_randomSeed));
+          std::shuffle(tests.begin(), tests.end(), gen);
+        }
+        else
+        {
+          std::shuffle(tests.begin(), tests.end(), m_generator);
+        }
+      }
+
+      // The schedule: tests in the order they are to be started. With a
+      // duration history, the longest tests start first so that none of them
+      // is left holding up the end of the run; a stable sort preserves the
+      // alphabetical or random order among tests of equal cost.
+      auto unknownCost = history.Mean();
+      std::vector<std::pair<DurationHistory::Duration, Test*>> schedule;
+      schedule.reserve(tests.size());
+      for (auto test : tests)
+      {
+        auto cost = unknownCost;
+        history.Lookup(test->GetSuiteName(), test->GetName(), cost);
+        schedule.push_back({cost, test});
+      }
+      if (useHistory)
+      {
+        std::stable_sort(schedule.begin(), schedule.end(),
+                         [] (const auto& a, const auto& b)
+                         { return a.first > b.first; });
+      }
+
+      std::vector<DurationHistory::Duration> costs;
+      costs.reserve(schedule.size());
+      for (std::size_t i = 0; i < schedule.size(); ++i)
+      {
+        costs.push_back(schedule[i].first);
+        tests[i] = schedule[i].second;
       }
 
       // Run each test.
+      auto numJobs = NumJobs(params, tests.size());
+      auto t1 = std::chrono::steady_clock::now();
+      // In-process, timeouts are enforced by a watchdog thread; isolated
+      // workers are timed by the runner.
+      std::unique_ptr<Watchdog> watchdog;
+      if (!(params.m_flags & RF_ISOLATE)
+          && std::any_of(tests.cbegin(), tests.cend(),
+                         [&] (const Test* t) { return Timeout(t, params).count() > 0; }))
+      {
+        watchdog = std::make_unique<Watchdog>(numJobs, outputter);
+      }
       Results rs;
-      rs.reserve(testNames.size());
-      for (auto& i : testNames)
+      if (numJobs == 1)
       {
-        Test* test = m[*i];
-        Result r = RunTest(test, params, outputter);
-        if (r.m_success) ++numSuccesses;
-        rs.push_back(std::move(r));
-        if (m_abort)
+        rs = RunTestsOn(tests, 1, params, outputter, watchdog.get());
+      }
+      else
+      {
+        // Exclusive tests (those that measure time) run one at a time once
+        // the others are done, so that no other test skews their timings.
+        auto exclusive = std::stable_partition(
+            tests.begin(), tests.end(),
+            [] (const Test* t) { return !t->IsExclusive(); });
+        std::vector<Test*> alone(exclusive, tests.end());
+        tests.erase(exclusive, tests.end());
+        rs = RunTestsOn(tests, numJobs, params, outputter, watchdog.get());
+        if (!alone.empty() && !m_cancellation.IsCancelled())
+        {
+          Results more = RunTestsOn(alone, 1, params, outputter, watchdog.get());
+          std::move(more.begin(), more.end(), std::back_inserter(rs));
+        }
+      }
+      watchdog.reset();
+      auto t2 = std::chrono::steady_clock::now();
+      m_cancellation.Reset();
+
+      if (useHistory)
+      {
+        if (!history.empty())
+        {
+          auto predicted = PredictCriticalPath(costs, numJobs);
+          auto actual = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1);
+          outputter->diagnostic(
+              Diagnostic(Cons<Nil>()
+                         << "Predicted critical path " << predicted.count() / 1000000
+                         << "ms, actual wall time " << actual.count() / 1000000
+                         << "ms on " << numJobs << " jobs."));
+        }
+        // Shards must all partition the run from the same history, so to
+        // them it is read-only; it is updated by unsharded runs.
+        if (params.m_shardCount <= 1)
         {
-          m_abort = false;
+          for (const auto& r : rs)
+          {
+            history.Record(r.m_suiteName, r.m_testName, r.m_duration);
+          }
+          if (!history.Save(params.m_historyFile))
+          {
+            outputter->diagnostic(
+                Diagnostic(Cons<Nil>()
+                           << "Could not write duration history to "
+                           << params.m_historyFile));
+          }
+        }
+      }
+
+      auto numSuccesses = static_cast<std::size_t>(
+          std::count_if(rs.cbegin(), rs.cend(),
+                        [] (const Result& r) { return r.m_success; }));
+      outputter->endRun(numTests, numSuccesses);
+      return rs;
+    }
+
+    // Keeps the tests that belong to shard m_shardIndex of m_shardCount.
+    // Without a duration history, tests are assigned by a stable hash of suite
+    // and test name. With one, they are assigned longest first to the least
+    // loaded shard, so that shards take about the same time. Either way the
+    // partition depends only on the registered tests and the history (which a
+    // sharded run doesn't update), so every machine computes the same one.
+    static std::vector<Test*> SelectShard(
+        const std::vector<Test*>& tests,
+        const RunParams& params,
+        const DurationHistory& history)
+    {
+      std::vector<Test*> selected;
+      if (history.empty())
+      {
+        std::copy_if(tests.cbegin(), tests.cend(),
+                     std::back_inserter(selected),
+                     [&] (const Test* t) {
+                       return StableHash(t->GetSuiteName(), t->GetName())
+                         % params.m_shardCount == params.m_shardIndex;
+                     });
+        return selected;
+      }
+
+      using Duration = DurationHistory::Duration;
+      struct Entry
+      {
+        Duration m_cost;
+        const Test* m_test;
+        std::size_t m_index;
+      };
+
+      auto unknownCost = history.Mean();
+      std::vector<Entry> entries;
+      entries.reserve(tests.size());
+      for (std::size_t i = 0; i < tests.size(); ++i)
+      {
+        auto cost = unknownCost;
+        history.Lookup(tests[i]->GetSuiteName(), tests[i]->GetName(), cost);
+        entries.push_back({cost, tests[i], i});
+      }
+      std::sort(entries.begin(), entries.end(),
+                [] (const Entry& a, const Entry& b) {
+                  if (a.m_cost != b.m_cost) return a.m_cost > b.m_cost;
+                  return CompareSuiteName()(a.m_test, b.m_test);
+                });
+
+      // Each shard's load is its total duration, then its number of tests.
+      std::vector<std::pair<Duration, std::size_t>> loads(
+          params.m_shardCount, {Duration::zero(), 0});
+      std::vector<char> mine(tests.size(), 0);
+      for (const auto& e : entries)
+      {
+        auto shard = std::min_element(loads.begin(), loads.end());
+        shard->first += e.m_cost;
+        ++shard->second;
+        if (static_cast<std::size_t>(shard - loads.begin()) == params.m_shardIndex)
+          mine[e.m_index] = 1;
+      }
+      for (std::size_t i = 0; i < tests.size(); ++i)
+      {
+        if (mine[i]) selected.push_back(tests[i]);
+      }
+      return selected;
+    }
+
+    Results RunTestsOn(const std::vector<Test*>& tests,
+                       std::size_t numJobs,
+                       const RunParams& params,
+                       const Outputter* outputter,
+                       Watchdog* watchdog)
+    {
+      if (tests.empty()) return Results();
+      return (params.m_flags & RF_ISOLATE)
+        ? RunTestsIsolated(tests, numJobs, params, outputter)
+        : numJobs == 1
+        ? RunTestsSerial(tests, params, outputter, watchdog)
+        : RunTestsParallel(tests, numJobs, params, outputter, watchdog);
+    }
+
+    static std::size_t NumJobs(const RunParams& params, std::size_t numTests)
+    {
+      std::size_t numJobs = params.m_numJobs;
+      if (numJobs == 0)
+      {
+        numJobs = std::max(std::thread::hardware_concurrency(), 1u);
+      }
+      return std::max(std::min(numJobs, numTests), std::size_t{1});
+    }
+
+    static std::chrono::milliseconds Timeout(const Test* test, const RunParams& params)
+    {
+      auto t = test->GetTimeout();
+      return t.count() > 0 ? t : params.m_timeout;
+    }
+
+    Results RunTestsSerial(const std::vector<Test*>& tests,
+                           const RunParams& params,
+                           const Outputter* outputter,
+                           Watchdog* watchdog = nullptr)
+    {
+      // The watchdog may report a timeout while a test is writing.
+      std::unique_ptr<LockedOutputter> locked;
+      if (watchdog)
+      {
+        locked = std::make_unique<LockedOutputter>(outputter, watchdog->OutputMutex());
+        outputter = locked.get();
+      }
+      Results rs;
+      rs.reserve(tests.size());
+      for (auto test : tests)
+      {
+        Watchdog::Scope watch(watchdog, 0, test->GetName(), Timeout(test, params));
+        rs.push_back(RunTest(test, params, outputter));
+        if (m_cancellation.IsCancelled()) break;
+      }
+      return rs;
+    }
+
+    // Each worker pulls the next test off the schedule and runs it against a
+    // buffered outputter; the buffer is replayed once the test finishes so that
+    // the output of concurrent tests does not interleave. Results are returned
+    // in schedule order, as they would be from a serial run.
+    Results RunTestsParallel(const std::vector<Test*>& tests,
+                             std::size_t numJobs,
+                             const RunParams& params,
+                             const Outputter* outputter,
+                             Watchdog* watchdog = nullptr)
+    {
+      std::vector<Result> slots(tests.size());
+      std::vector<char> ran(tests.size(), 0);
+      std::atomic<std::size_t> next{0};
+      // A watchdog reports a timeout under the same mutex as the replays.
+      std::mutex ownMutex;
+      std::mutex& outputMutex = watchdog ? watchdog->OutputMutex() : ownMutex;
+
+      auto worker = [&] (std::size_t slot) {
+        BufferedOutputter buffer;
+        for (std::size_t i = next++;
+             i < tests.size() && !m_cancellation.IsCancelled();
+             i = next++)
+        {
+          Watchdog::Scope watch(
+              watchdog, slot, tests[i]->GetName(), Timeout(tests[i], params));
+          slots[i] = RunTest(tests[i], params, &buffer);
+          ran[i] = 1;
+          std::lock_guard<std::mutex> lock(outputMutex);
+          buffer.replay(outputter);
+          buffer.clear();
+        }
+      };
+
+      std::vector<std::thread> workers;
+      for (std::size_t i = 1; i < numJobs; ++i)
+      {
+        workers.emplace_back(worker, i);
+      }
+      worker(0);
+      for (auto& t : workers)
+      {
+        t.join();
+      }
+
+      Results rs;
+      for (std::size_t i = 0; i < tests.size(); ++i)
+      {
+        if (ran[i]) rs.push_back(std::move(slots[i]));
+      }
+      return rs;
+    }
+
+    // Runs each test in one of a pool of worker processes forked from this
+    // one: since registration has already happened, a worker is ready to run
+    // tests straight away. Each worker pulls test indexes off a pipe and sends
+    // back its outputter calls and results. If a worker dies, the test it was
+    // running fails and a new worker replaces it.
+    Results RunTestsIsolated(const std::vector<Test*>& tests,
+                             std::size_t numJobs,
+                             const RunParams& params,
+                             const Outputter* outputter)
+    {
+#ifdef TESTINATOR_ISOLATION_SUPPORTED
+      using namespace isolation;
+      static const std::size_t NO_TEST = static_cast<std::size_t>(-1);
+
+      struct Worker
+      {
+        pid_t m_pid = -1;
+        int m_commandFd = -1;
+        int m_resultFd = -1;
+        std::size_t m_test = NO_TEST;
+        std::chrono::steady_clock::time_point m_deadline;
+        BufferedOutputter m_buffer;
+        bool m_started = false;
+      };
+
+      std::vector<Result> slots(tests.size());
+      std::vector<char> ran(tests.size(), 0);
+      std::size_t next = 0;
+      std::vector<Worker> workers(numJobs);
+      IgnoreSigpipe ignoreSigpipe;
+      CancelOnSignal cancelOnSignal(m_cancellation);
+
+      auto serve = [&] (int commandFd, int resultFd) {
+        PipeOutputter op(resultFd);
+        uint64_t i;
+        while (Read(commandFd, i))
+        {
+          Result r = RunTest(tests[static_cast<std::size_t>(i)], params, &op);
+          std::cout.flush();
+          std::fflush(nullptr);
+          uint64_t flags = 0;
+          if (r.m_success) flags |= RESULT_SUCCESS;
+          if (m_cancellation.IsCancelled()) flags |= RESULT_ABORT;
+          m_cancellation.Reset();
+          WriteMessage(resultFd, {MSG_RESULT, flags,
+                                  std::to_string(r.m_duration.count()),
+                                  std::string()});
+        }
+      };
+
+      auto spawnFailed = [&] (int err) {
+        outputter->diagnostic(
+            Diagnostic(Cons<Nil>()
+                       << "Could not start a worker process: " << std::strerror(err)));
+        return false;
+      };
+
+      auto spawn = [&] (Worker& w) {
+        int command[2];
+        int result[2];
+        if (pipe(command) != 0) return spawnFailed(errno);
+        if (pipe(result) != 0)
+        {
+          int err = errno;
+          close(command[0]);
+          close(command[1]);
+          return spawnFailed(err);
+        }
+        // Don't let buffered output be duplicated in the child.
+        std::cout.flush();
+        std::fflush(nullptr);
+        pid_t pid = fork();
+        int err = errno;
+        if (pid == 0)
+        {
+          close(command[1]);
+          close(result[0]);
+          for (auto& other : workers)
+          {
+            if (other.m_pid <= 0) continue;
+            close(other.m_commandFd);
+            close(other.m_resultFd);
+          }
+          serve(command[0], result[1]);
+          _exit(0);
+        }
+        close(command[0]);
+        close(result[1]);
+        if (pid < 0)
+        {
+          close(command[1]);
+          close(result[0]);
+          return spawnFailed(err);
+        }
+        w.m_pid = pid;
+        w.m_commandFd = command[1];
+        w.m_resultFd = result[0];
+        return true;
+      };
+
+      auto dispatch = [&] (Worker& w) {
+        if (next >= tests.size() || m_cancellation.IsCancelled()) return;
+        if (w.m_pid <= 0 && !spawn(w)) return;
+        uint64_t i = next++;
+        std::string buf;
+        Append(buf, i);
+        WriteAll(w.m_commandFd, buf.data(), buf.size());
+        w.m_test = static_cast<std::size_t>(i);
+        w.m_started = false;
+        auto timeout = Timeout(tests[w.m_test], params);
+        w.m_deadline = timeout.count() > 0
+          ? std::chrono::steady_clock::now() + timeout
+          : std::chrono::steady_clock::time_point::max();
+      };
+
+      auto retire = [&] (Worker& w) {
+        close(w.m_commandFd);
+        close(w.m_resultFd);
+        int status = 0;
+        waitpid(w.m_pid, &status, 0);
+        w.m_pid = -1;
+        return status;
+      };
+
+      for (auto& w : workers)
+      {
+        dispatch(w);
+      }
+
+      // A worker may die before it has started its test (in Setup, say); the
+      // test's failure must still be reported as a started test's.
+      auto ensureStarted = [&] (Worker& w) {
+        if (!w.m_started) w.m_buffer.startTest(tests[w.m_test]->GetName());
+        w.m_started = true;
+      };
+
+      // Kills a worker in the middle of its test, which fails.
+      auto abandon = [&] (Worker& w) {
+        Test* test = tests[w.m_test];
+        Result& r = slots[w.m_test];
+        kill(w.m_pid, SIGKILL);
+        retire(w);
+        r.m_suiteName = test->GetSuiteName();
+        r.m_testName = test->GetName();
+        r.m_success = false;
+        ensureStarted(w);
+      };
+
+      // A worker whose test overruns its timeout is killed; the test fails and
+      // the worker is replaced.
+      auto expire = [&] (Worker& w) {
+        Test* test = tests[w.m_test];
+        abandon(w);
+        slots[w.m_test].m_duration = Timeout(test, params);
+        w.m_buffer.abort(
+            Diagnostic(Cons<Nil>()
+                       << test->GetName() << " timed out after "
+                       << Timeout(test, params).count() << "ms"));
+        w.m_buffer.endTest(test->GetName(), false);
+      };
+
+      std::vector<pollfd> fds;
+      std::vector<Worker*> busy;
+      for (;;)
+      {
+        fds.clear();
+        busy.clear();
+        auto deadline = std::chrono::steady_clock::time_point::max();
+        for (auto& w : workers)
+        {
+          if (w.m_test == NO_TEST) continue;
+          fds.push_back({w.m_resultFd, POLLIN, 0});
+          busy.push_back(&w);
+          deadline = std::min(deadline, w.m_deadline);
+        }
+        if (busy.empty()) break;
+
+        int pollTimeout = -1;
+        if (deadline != std::chrono::steady_clock::time_point::max())
+        {
+          // round up, so as not to wake just before the deadline
+          auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+              deadline - std::chrono::steady_clock::now()).count() + 1;
+          pollTimeout = static_cast<int>(std::max(wait, decltype(wait){0}));
+        }
+        if (poll(fds.data(), fds.size(), pollTimeout) < 0)
+        {
+          int err = errno;
+          if (err == EINTR) continue;
+          // The workers can no longer be watched, so the run stops: they are
+          // killed (a hung one would never exit) and their tests fail.
+          outputter->abort(
+              Diagnostic(Cons<Nil>() << "poll failed: " << std::strerror(err)));
+          m_cancellation.Cancel();
+          for (auto w : busy)
+          {
+            Test* test = tests[w->m_test];
+            abandon(*w);
+            w->m_buffer.diagnostic(test->GetName() + ": worker process killed");
+            w->m_buffer.endTest(test->GetName(), false);
+            ran[w->m_test] = 1;
+            w->m_test = NO_TEST;
+            w->m_buffer.replay(outputter);
+            w->m_buffer.clear();
+          }
           break;
         }
+
+        for (std::size_t j = 0; j < busy.size(); ++j)
+        {
+          if (fds[j].revents == 0
+              && std::chrono::steady_clock::now() < busy[j]->m_deadline)
+            continue;
+          Worker& w = *busy[j];
+          Test* test = tests[w.m_test];
+          Result& r = slots[w.m_test];
+
+          Message msg;
+          if (fds[j].revents == 0 && std::chrono::steady_clock::now() >= w.m_deadline)
+          {
+            expire(w);
+          }
+          else if (ReadMessage(w.m_resultFd, msg))
+          {
+            if (msg.m_kind == MSG_START_TEST) w.m_started = true;
+            if (Forward(msg, &w.m_buffer)) continue;
+            r.m_suiteName = test->GetSuiteName();
+            r.m_testName = test->GetName();
+            r.m_success = (msg.m_n & RESULT_SUCCESS) != 0;
+            r.m_duration = std::chrono::nanoseconds(std::stoll(msg.m_s1));
+            // Pass a cancellation on to the workers still running tests.
+            if ((msg.m_n & RESULT_ABORT) && m_cancellation.Cancel())
+            {
+              for (auto& other : workers)
+              {
+                if (other.m_test != NO_TEST && &other != &w)
+                  kill(other.m_pid, SIGUSR1);
+              }
+            }
+          }
+          else
+          {
+            int status = retire(w);
+            r.m_suiteName = test->GetSuiteName();
+            r.m_testName = test->GetName();
+            r.m_success = false;
+            ensureStarted(w);
+            w.m_buffer.diagnostic(
+                Diagnostic(Cons<Nil>()
+                           << test->GetName() << ": worker process "
+                           << DescribeExit(status)));
+            w.m_buffer.endTest(test->GetName(), false);
+          }
+
+          ran[w.m_test] = 1;
+          w.m_test = NO_TEST;
+          w.m_buffer.replay(outputter);
+          w.m_buffer.clear();
+          dispatch(w);
+        }
+      }
+
+      // If no worker could be started, the tests left over fail rather than
+      // go missing from the results.
+      for (; next < tests.size() && !m_cancellation.IsCancelled(); ++next)
+      {
+        Test* test = tests[next];
+        Result& r = slots[next];
+        r.m_suiteName = test->GetSuiteName();
+        r.m_testName = test->GetName();
+        r.m_success = false;
+        outputter->startTest(test->GetName());
+        outputter->diagnostic(test->GetName() + ": no worker process to run it");
+        outputter->endTest(test->GetName(), false);
+        ran[next] = 1;
+      }
+
+      for (auto& w : workers)
+      {
+        if (w.m_pid > 0) retire(w);
       }
 
-      outputter->endRun(m.size(), numSuccesses);
+      Results rs;
+      for (std::size_t i = 0; i < tests.size(); ++i)
+      {
+        if (ran[i]) rs.push_back(std::move(slots[i]));
+      }
       return rs;
+#else
+      outputter->diagnostic(
+          "Test isolation is not supported on this platform; running in-process.");
+      return numJobs == 1
+        ? RunTestsSerial(tests, params, outputter)
+        : RunTestsParallel(tests, numJobs, params, outputter);
+#endif
     }
 
     Result RunTest(Test* test,
@@ -163,27 +926,46 @@ namespace testinator
                    const Outputter* outputter)
     {
       Result r;
+      r.m_suiteName = test->GetSuiteName();
+      r.m_testName = test->GetName();
+      auto t1 = std::chrono::steady_clock::now();
       if (test->Setup(params))
       {
         outputter->startTest(test->GetName());
-        r = test->RunWrapper(outputter);
-        if (!test->skipped())
+        CancellationToken::Interrupted() = false;
+        r.m_success = test->RunWrapper(outputter).m_success;
+        if (r.m_success && CancellationToken::Interrupted())
+          outputter->skipTest(test->GetName(), "cancelled");
+        else if (!test->skipped())
           outputter->endTest(test->GetName(), r.m_success);
+        if (!r.m_success && (params.m_flags & RF_FAIL_FAST) && m_cancellation.Cancel())
+          outputter->abort(test->GetName() + " failed; cancelling the run");
       }
       else
       {
+        r.m_success = true;
         outputter->skipTest(test->GetName(), std::string());
       }
+      auto t2 = std::chrono::steady_clock::now();
+      r.m_duration = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1);
       return r;
     }
 
-    TestMap m_tests;
-    TestNameMap m_testNames;
-    TestSuiteMap m_testsBySuite;
-    TestSuiteNameMap m_suiteNames;
+    // Registered tests in order of registration, with nulls where tests were
+    // unregistered.
+    std::vector<Test*> m_tests;
+    std::size_t m_numUnregistered = 0;
+    // Tests before this index are part of a run in progress.
+    std::size_t m_firstRunnable = 0;
+
+    std::vector<Test*> m_byName;
+    std::vector<Test*> m_bySuite;
+    bool m_byNameValid = false;
+    bool m_bySuiteValid = false;
 
     std::mt19937 m_generator;
-    bool m_abort = false;
+    CancellationToken m_cancellation;
+    std::mutex m_mutex;
   };
 
   //------------------------------------------------------------------------------
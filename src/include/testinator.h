@@ -4,6 +4,9 @@
 #pragma once
 
 #include "complexity.h"
+#include "fuzz.h"
+#include "generator.h"
+#include "list_tests.h"
 #include "main.h"
 #include "property.h"
 #include "test.h"
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include "cancellation.h"
 #include "output.h"
 #include "test_macros.h"
 
@@ -23,16 +24,19 @@ namespace testinator
     {
     }
 
-    void check(std::size_t N, const Outputter* outputter)
+    // Stops early (without reporting a time) if the token is cancelled.
+    void check(std::size_t N, const Outputter* outputter,
+               const CancellationToken* token = nullptr)
     {
-      m_internal->check(N, outputter);
+      m_internal->check(N, outputter, token);
     }
 
   private:
     struct InternalBase
     {
       virtual ~InternalBase() {}
-      virtual void check(std::size_t N, const Outputter*) = 0;
+      virtual void check(std::size_t N, const Outputter*,
+                         const CancellationToken*) = 0;
     };
 
     template <typename U>
@@ -41,11 +45,13 @@ namespace testinator
       Internal(const U& u) : m_u(u) {}
 
       virtual void check(std::size_t N,
-                         const Outputter* op)
+                         const Outputter* op,
+                         const CancellationToken* token)
       {
         auto t1 = std::chrono::high_resolution_clock::now();
         for (std::size_t i = 0; i < N; ++i)
         {
+          if (token != nullptr && token->Poll()) return;
           m_u();
         }
         auto t2 = std::chrono::high_resolution_clock::now();
@@ -87,9 +93,13 @@ namespace testinator
     virtual bool Run()                                     \
     {                                                      \
       testinator::TimedTest p(*this);                      \
-      p.check(m_numChecks, m_op);                          \
+      p.check(m_numChecks, m_op, &Cancellation());         \
       return true;                                         \
     }                                                      \
+    virtual const char* GetType() const                    \
+    { return "TIMED_TEST"; }                               \
+    virtual bool IsExclusive() const                       \
+    { return true; }                                       \
     void operator()();                                     \
     size_t m_numChecks;                                    \
   } s_##SUITE##NAME##_TimedTest;                           \
@@ -0,0 +1,161 @@
+// Copyright (c) 2014-2016 Ben Deane
+// This code is distributed under the MIT license. See LICENSE for details.
+
+#pragma once
+
+#include "branch.h"
+#include "output.h"
+#include "test_macros.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace testinator
+{
+  //------------------------------------------------------------------------------
+  // Enforces test timeouts when tests run in-process. Each worker (slot) tells
+  // the watchdog when it starts and finishes a test; if a test overruns, there
+  // is no way to stop its thread, so the watchdog reports the test and the
+  // branches it was in, and exits the process. Its report goes out under the
+  // output mutex, which the runner must also hold while it writes.
+  class Watchdog
+  {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    Watchdog(std::size_t numSlots, const Outputter* outputter)
+      : m_watches(numSlots)
+      , m_outputter(outputter)
+      , m_thread([this] () { Run(); })
+    {
+    }
+
+    ~Watchdog()
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+      }
+      m_cv.notify_one();
+      m_thread.join();
+    }
+
+    std::mutex& OutputMutex()
+    {
+      return m_outputMutex;
+    }
+
+    // Watches the test running on the calling thread until destroyed.
+    class Scope
+    {
+    public:
+      Scope(Watchdog* w, std::size_t slot, const std::string& name,
+            std::chrono::milliseconds timeout)
+        : m_watchdog(timeout.count() > 0 ? w : nullptr)
+        , m_slot(slot)
+      {
+        if (m_watchdog) m_watchdog->Start(slot, name, timeout);
+      }
+
+      ~Scope()
+      {
+        if (m_watchdog) m_watchdog->Stop(m_slot);
+      }
+
+    private:
+      Watchdog* m_watchdog;
+      std::size_t m_slot;
+    };
+
+  private:
+    struct Watch
+    {
+      bool m_active = false;
+      std::string m_name;
+      std::chrono::milliseconds m_timeout{0};
+      Clock::time_point m_deadline;
+      BranchNames m_branches;
+    };
+
+    void Start(std::size_t slot, const std::string& name,
+               std::chrono::milliseconds timeout)
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Watch& w = m_watches[slot];
+        w.m_active = true;
+        w.m_name = name;
+        w.m_timeout = timeout;
+        w.m_deadline = Clock::now() + timeout;
+        w.m_branches.clear();
+        BranchNames::current() = &w.m_branches;
+      }
+      m_cv.notify_one();
+    }
+
+    void Stop(std::size_t slot)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_watches[slot].m_active = false;
+      BranchNames::current() = nullptr;
+    }
+
+    void Run()
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      while (!m_stop)
+      {
+        auto now = Clock::now();
+        auto next = Clock::time_point::max();
+        for (const auto& w : m_watches)
+        {
+          if (!w.m_active) continue;
+          if (w.m_deadline <= now) Expire(w);
+          next = std::min(next, w.m_deadline);
+        }
+        if (next == Clock::time_point::max())
+          m_cv.wait(lock);
+        else
+          m_cv.wait_until(lock, next);
+      }
+    }
+
+    [[noreturn]] void Expire(const Watch& w)
+    {
+      // The test's thread is still running, so its branches are read from
+      // the names it publishes, not from its own stack.
+      std::lock_guard<std::mutex> lock(m_outputMutex);
+      m_outputter->abort(
+          Diagnostic(Cons<Nil>()
+                     << w.m_name << " timed out after "
+                     << w.m_timeout.count() << "ms"));
+      for (const auto& name : w.m_branches.get())
+      {
+        if (name != "(root)") m_outputter->diagnostic("  in branch " + name);
+      }
+
+      // Other threads may still be running tests, so static destructors must
+      // not run.
+      std::cout.flush();
+      std::fflush(nullptr);
+      std::_Exit(EXIT_FAILURE);
+    }
+
+    std::vector<Watch> m_watches;
+    const Outputter* m_outputter;
+    bool m_stop = false;
+    std::mutex m_mutex;
+    std::mutex m_outputMutex;
+    std::condition_variable m_cv;
+    std::thread m_thread;
+  };
+}
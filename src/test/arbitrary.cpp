@@ -3,6 +3,12 @@
 
 #include <test.h>
 #include <arbitrary.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <utility>
 using namespace std;
 
 //------------------------------------------------------------------------------
@@ -326,3 +332,270 @@ DEF_TEST(unordered_map, Arbitrary)
   return vv.size() == 2
     && vv[0].size() + vv[1].size() == v.size();
 }
+
+//------------------------------------------------------------------------------
+DEF_TEST(SameSeed, Arbitrary)
+{
+  // generation depends only on the seed, so it is reproducible on any thread
+  testinator::Arbitrary<vector<int>> a;
+  vector<int> v = a.generate_n(100, 1234);
+  vector<int> w;
+  thread t([&] () { w = a.generate_n(100, 1234); });
+  t.join();
+  return v == w && v != a.generate_n(100, 1235);
+}
+
+//------------------------------------------------------------------------------
+DEF_TEST(ElementStreams, Arbitrary)
+{
+  // each element has its own stream: a container's elements don't repeat the
+  // values of its neighbouring seeds' containers
+  testinator::Arbitrary<vector<int>> a;
+  vector<int> v = a.generate_n(100, 1);
+  vector<int> w = a.generate_n(100, 2);
+  return !equal(v.cbegin() + 1, v.cend(), w.cbegin());
+}
+
+//------------------------------------------------------------------------------
+DEF_TEST(Xoshiro256x4, Arbitrary)
+{
+  // known answers: the lanes give the same values with or without SIMD
+  testinator::Xoshiro256x4 gen(42);
+  uint64_t out[8];
+  gen.Generate(out, 2);
+  return out[0] == 0x0dc3ec305728c5d8ull
+    && out[1] == 0xfe647e5153400883ull
+    && out[2] == 0x038ffc155f1cace3ull;
+}
+
+//------------------------------------------------------------------------------
+DEF_TEST(GenerateBatch, Arbitrary)
+{
+  char cs[1000];
+  testinator::GenerateBatch(cs, 1000, 5, 1234);
+  bool printable = all_of(cs, cs + 1000, [] (char c) { return c >= 32 && c <= 126; });
+
+  int is[1000];
+  int js[1000];
+  testinator::GenerateBatch(is, 1000, 5, 1234);
+  testinator::GenerateBatch(js, 1000, 5, 1234);
+  bool inRange = none_of(is, is + 1000, [] (int i) {
+      return i == numeric_limits<int>::min() || i == numeric_limits<int>::max(); });
+
+  // the edge cases of early generations apply to the whole batch
+  testinator::GenerateBatch(js, 1000, 2, 1234);
+  bool maxes = all_of(js, js + 1000, [] (int i) { return i == numeric_limits<int>::max(); });
+
+  // types without generate_batch are generated a value at a time
+  pair<int, int> ps[10];
+  testinator::GenerateBatch(ps, 10, 5, 1234);
+
+  return printable && inRange && maxes
+    && testinator::has_generate_batch<double>::value
+    && !testinator::has_generate_batch<pair<int, int>>::value
+    && ps[0] != ps[1];
+}
+
+//------------------------------------------------------------------------------
+DEF_TEST(ChoiceReplay, Arbitrary)
+{
+  // recording doesn't change the value, and replaying the choices reproduces
+  // it; replaying no choices gives the simplest value
+  using T = pair<vector<int>, string>;
+  T v = testinator::Arbitrary<T>::generate(150, 1234);
+
+  testinator::ChoiceSequence record;
+  T recorded;
+  {
+    testinator::ChoiceSequence::Scope scope(record);
+    recorded = testinator::Arbitrary<T>::generate(150, 1234);
+  }
+
+  testinator::ChoiceSequence replay(record.Choices());
+  testinator::ChoiceSequence empty(vector<uint64_t>{});
+  T replayed;
+  T simplest;
+  {
+    testinator::ChoiceSequence::Scope scope(replay);
+    replayed = testinator::Arbitrary<T>::generate(150, 1);
+  }
+  {
+    testinator::ChoiceSequence::Scope scope(empty);
+    simplest = testinator::Arbitrary<T>::generate(150, 1234);
+  }
+  return recorded == v && replayed == v
+    && simplest.first.empty() && simplest.second.empty();
+}
+
+//------------------------------------------------------------------------------
+namespace
+{
+  // regenerating over the value of one seed gives the value of another
+  template <typename T>
+  bool RegeneratesAsGenerated(std::size_t generation)
+  {
+    testinator::GenerationSize::Scope size(20);
+    T t = testinator::Arbitrary<T>::generate(generation, 1);
+    bool same = true;
+    for (unsigned long seed = 2; seed < 20; ++seed)
+    {
+      testinator::Regenerate(t, generation, seed);
+      same = same && t == testinator::Arbitrary<T>::generate(generation, seed);
+    }
+    return same;
+  }
+}
+
+DEF_TEST(Regenerate, Arbitrary)
+{
+  return RegeneratesAsGenerated<vector<string>>(7)
+    && RegeneratesAsGenerated<string>(7)
+    && RegeneratesAsGenerated<vector<bool>>(7)
+    && RegeneratesAsGenerated<deque<int>>(7)
+    && RegeneratesAsGenerated<list<string>>(7)
+    && RegeneratesAsGenerated<array<string, 3>>(7)
+    && RegeneratesAsGenerated<map<int, string>>(7)
+    && RegeneratesAsGenerated<unordered_set<int>>(7)
+    && RegeneratesAsGenerated<tuple<int, vector<int>, pair<string, char>>>(7)
+    && RegeneratesAsGenerated<vector<int>>(0)
+    && testinator::has_regenerate<vector<int>>::value
+    && !testinator::has_regenerate<int>::value;
+}
+
+DEF_TEST(RegenerateKeepsCapacity, Arbitrary)
+{
+  testinator::GenerationSize::Scope size(50);
+  vector<string> v(50, string(100, 'x'));
+  const string* data = v.data();
+  const char* first = v[0].data();
+  unsigned long seed = 1;
+  while (testinator::ContainerSize(5, 1, seed) == 0) ++seed;
+  testinator::Regenerate(v, 1, seed);
+  return v.data() == data && v[0].data() == first;
+}
+
+//------------------------------------------------------------------------------
+DEF_TEST(CollidingKeys, Arbitrary)
+{
+  using S = testinator::HashKeys<unordered_set<int>, testinator::KEYS_COLLIDING>;
+  S s = testinator::Arbitrary<S>::generate_n(1000, 1234);
+  size_t b = s.bucket(*s.begin());
+  return s.size() == 1000 && s.bucket_size(b) == s.size();
+}
+
+DEF_TEST(CollidingStringKeys, Arbitrary)
+{
+  using M = testinator::HashKeys<unordered_map<string, int>, testinator::KEYS_COLLIDING>;
+  M m = testinator::Arbitrary<M>::generate_n(20, 1234);
+  size_t b = m.bucket(m.begin()->first);
+  return m.size() == 20 && m.bucket_size(b) == m.size();
+}
+
+DEF_TEST(SequentialKeys, Arbitrary)
+{
+  using S = testinator::HashKeys<unordered_set<unsigned>, testinator::KEYS_SEQUENTIAL>;
+  S s = testinator::Arbitrary<S>::generate_n(100, 1234);
+  vector<unsigned> v(s.cbegin(), s.cend());
+  sort(v.begin(), v.end());
+  // (unless they wrap)
+  return s.size() == 100
+    && (v.back() - v.front() == 99u || v.front() == 0u);
+}
+
+DEF_TEST(ClusteredKeys, Arbitrary)
+{
+  using S = testinator::HashKeys<unordered_set<int>, testinator::KEYS_CLUSTERED>;
+  S s = testinator::Arbitrary<S>::generate_n(160, 1234);
+  size_t runs = 0;
+  for (int k : s)
+  {
+    runs += s.count(k - 1) == 0 ? 1u : 0u;
+  }
+  return s.size() == 160 && runs <= 10;
+}
+
+DEF_TEST(KeysLoadFactor, Arbitrary)
+{
+  using S = testinator::HashKeys<unordered_set<int>, testinator::KEYS_UNIFORM, 50>;
+  S s = testinator::Arbitrary<S>::generate_n(100, 1234);
+  S small = testinator::Arbitrary<S>::generate(1, 1234);
+  auto v = testinator::Arbitrary<S>::shrink(s);
+  return s.size() == 100 && s.max_load_factor() == 0.5f
+    && s.load_factor() <= 0.5f && small.size() == 5
+    && v.size() == 2 && v[0].size() + v[1].size() == 100
+    && v[0].max_load_factor() == 0.5f;
+}
+
+//------------------------------------------------------------------------------
+DEF_TEST(SortedShapes, Arbitrary)
+{
+  using testinator::Arbitrary;
+  using testinator::Shaped;
+  auto s = Arbitrary<Shaped<vector<int>, testinator::SHAPE_SORTED>>::generate_n(100, 1234);
+  auto r = Arbitrary<Shaped<deque<int>, testinator::SHAPE_REVERSED>>::generate_n(100, 1234);
+  auto l = Arbitrary<Shaped<list<int>, testinator::SHAPE_SORTED>>::generate_n(100, 1234);
+  auto str = Arbitrary<Shaped<string, testinator::SHAPE_REVERSED>>::generate_n(100, 1234);
+  auto v = Arbitrary<vector<int>>::generate_n(100, 1234);
+  sort(v.begin(), v.end());
+  return s.size() == 100 && equal(v.cbegin(), v.cend(), s.cbegin())
+    && equal(v.crbegin(), v.crend(), r.cbegin())
+    && is_sorted(l.cbegin(), l.cend()) && l.size() == 100
+    && is_sorted(str.crbegin(), str.crend()) && str.size() == 100;
+}
+
+DEF_TEST(NearlySortedShape, Arbitrary)
+{
+  using S = testinator::Shaped<vector<int>, testinator::SHAPE_NEARLY_SORTED, 3>;
+  S v = testinator::Arbitrary<S>::generate_n(100, 1234);
+  vector<int> sorted(v);
+  sort(sorted.begin(), sorted.end());
+  bool near = true;
+  for (size_t i = 0; i < v.size(); ++i)
+  {
+    auto range = equal_range(sorted.cbegin(), sorted.cend(), v[i]);
+    size_t lo = static_cast<size_t>(range.first - sorted.cbegin());
+    size_t hi = static_cast<size_t>(range.second - sorted.cbegin());
+    near = near && i + 3 >= lo && i < hi + 3;
+  }
+  return v.size() == 100 && near && !is_sorted(v.cbegin(), v.cend());
+}
+
+DEF_TEST(OrganPipeShape, Arbitrary)
+{
+  using S = testinator::Shaped<list<int>, testinator::SHAPE_ORGAN_PIPE>;
+  S l = testinator::Arbitrary<S>::generate_n(101, 1234);
+  vector<int> v(l.cbegin(), l.cend());
+  auto peak = max_element(v.cbegin(), v.cend());
+  return v.size() == 101
+    && is_sorted(v.cbegin(), peak + 1)
+    && is_sorted(v.crbegin(), vector<int>::const_reverse_iterator(peak));
+}
+
+DEF_TEST(FewUniqueShapes, Arbitrary)
+{
+  using F = testinator::Shaped<vector<int>, testinator::SHAPE_FEW_UNIQUE, 4>;
+  using E = testinator::Shaped<deque<string>, testinator::SHAPE_ALL_EQUAL>;
+  F f = testinator::Arbitrary<F>::generate_n(100, 1234);
+  E e = testinator::Arbitrary<E>::generate_n(10, 1234);
+  sort(f.begin(), f.end());
+  auto few = static_cast<size_t>(unique(f.begin(), f.end()) - f.begin());
+  auto v = testinator::Arbitrary<E>::shrink(e);
+  return few <= 4 && few > 1
+    && e.size() == 10 && count(e.cbegin(), e.cend(), e[0]) == 10
+    && v.size() == 2 && v[1].size() == 5 && v[1][0] == e[0];
+}
+
+DEF_TEST(ShapedShrink, Arbitrary)
+{
+  using S = testinator::Shaped<vector<int>, testinator::SHAPE_ORGAN_PIPE>;
+  S s = testinator::Arbitrary<S>::generate(150, 1234);
+  auto v = testinator::Arbitrary<S>::shrink(s);
+  bool shaped = !v.empty();
+  for (const auto& h : v)
+  {
+    auto peak = max_element(h.cbegin(), h.cend());
+    shaped = shaped && is_sorted(h.cbegin(), peak)
+      && is_sorted(h.crbegin(), vector<int>::const_reverse_iterator(peak));
+  }
+  return shaped;
+}
@@ -5,6 +5,7 @@
 
 #include <algorithm>
 #include <string>
+#include <unordered_set>
 using namespace std;
 
 DEF_COMPLEXITY_PROPERTY(O_1, Complexity, ORDER_1, const string&, int)
@@ -63,3 +64,34 @@ struct MyUnspecializedType {};
 DEF_COMPLEXITY_PROPERTY(ArbitraryCoverage, Complexity, ORDER_N2, const MyUnspecializedType&)
 {
 }
+
+size_t g_n;
+
+// With colliding keys, a lookup searches one long bucket.
+DEF_COMPLEXITY_PROPERTY(CollidingKeys, Complexity, ORDER_N,
+                        const testinator::HashKeys<unordered_set<unsigned>,
+                                                   testinator::KEYS_COLLIDING>& s)
+{
+  if (s.empty()) return;
+  // The keys step from the first by the bucket count (std::hash is the
+  // identity), so stepping that far again from any key misses, in the same
+  // bucket.
+  unsigned k = *s.begin()
+    + static_cast<unsigned>(s.size() * s.bucket_count());
+  g_n = s.count(k);
+}
+
+// Insertion sort is at its best on sorted input.
+DEF_COMPLEXITY_PROPERTY(SortedShape, Complexity, ORDER_N,
+                        const testinator::Shaped<vector<int>, testinator::SHAPE_SORTED>& s)
+{
+  vector<int> v(s);
+  for (auto i = v.begin(); i != v.end(); ++i)
+  {
+    for (auto j = i; j != v.begin() && *j < *(j - 1); --j)
+    {
+      iter_swap(j, j - 1);
+    }
+  }
+  g_n = v.size();
+}
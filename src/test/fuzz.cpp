@@ -0,0 +1,23 @@
+// Copyright (c) 2014-2016 Ben Deane
+// This code is distributed under the MIT license. See LICENSE for details.
+
+// Built as a libFuzzer target (see fuzz.h and TESTINATOR_ADD_FUZZER): each
+// input is a case for the property, which holds, so a short run finds nothing.
+
+#include <testinator.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+DEF_PROPERTY(SortIdempotent, Fuzz, const vector<string>& v)
+{
+  vector<string> s(v);
+  sort(s.begin(), s.end());
+  vector<string> t(s);
+  sort(t.begin(), t.end());
+  return s == t && is_permutation(s.cbegin(), s.cend(), v.cbegin());
+}
@@ -0,0 +1,142 @@
+// Copyright (c) 2014-2016 Ben Deane
+// This code is distributed under the MIT license. See LICENSE for details.
+
+#include <generator.h>
+#include <property.h>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+using namespace testinator;
+
+//------------------------------------------------------------------------------
+DEF_TEST(InRange, Generator)
+{
+  auto g = gen::InRange(-5, 5);
+  bool inRange = true;
+  vector<int> seen;
+  for (unsigned long seed = 0; seed < 1000; ++seed)
+  {
+    int i = g.generate(1, seed);
+    inRange = inRange && i >= -5 && i <= 5;
+    seen.push_back(i);
+  }
+  sort(seen.begin(), seen.end());
+  auto d = gen::InRange(0.5, 1.0).generate(1, 1234);
+  auto all = gen::InRange(numeric_limits<long long>::min(),
+                          numeric_limits<long long>::max());
+  return inRange && unique(seen.begin(), seen.end()) - seen.begin() == 11
+    && g.generate(0, 1234) == -5 && d >= 0.5 && d <= 1.0
+    && all.generate(1, 1) != all.generate(1, 2)
+    && g.shrink(4) == vector<int>{-5, -1} && g.shrink(-5).empty();
+}
+
+DEF_TEST(ElementOf, Generator)
+{
+  auto g = gen::ElementOf(string("one"), "two", "three");
+  bool found = true;
+  for (unsigned long seed = 0; seed < 100; ++seed)
+  {
+    string s = g.generate(1, seed);
+    found = found && (s == "one" || s == "two" || s == "three");
+  }
+  return found && g.generate(0, 1234) == "one"
+    && g.shrink("three") == vector<string>{"one", "two"};
+}
+
+DEF_TEST(MapFilter, Generator)
+{
+  auto even = gen::Map(gen::InRange(0, 49), [] (int i) { return i * 2; });
+  auto big = gen::Filter(gen::InRange(0, 99), [] (int i) { return i >= 50; });
+  bool ok = true;
+  for (unsigned long seed = 0; seed < 100; ++seed)
+  {
+    int e = even.generate(1, seed);
+    int b = big.generate(1, seed);
+    ok = ok && e % 2 == 0 && e < 100 && b >= 50;
+  }
+  auto odd = gen::Filter(gen::InRange(0, 99), [] (int i) { return i % 2 == 1; });
+  return ok && big.shrink(98).empty() && odd.shrink(99) == vector<int>{49}
+    && even.shrink(4).empty();
+}
+
+DEF_TEST(Bind, Generator)
+{
+  // a length, then a vector of that many small values
+  auto g = gen::Bind(gen::InRange<size_t>(1, 10), [] (size_t n) {
+      return gen::Map(gen::InRange(0, 9), [n] (int i) { return vector<int>(n, i); });
+    });
+  bool ok = true;
+  for (unsigned long seed = 0; seed < 100; ++seed)
+  {
+    auto v = g.generate(1, seed);
+    ok = ok && !v.empty() && v.size() <= 10
+      && count(v.cbegin(), v.cend(), v[0]) == static_cast<ptrdiff_t>(v.size());
+  }
+  return ok;
+}
+
+DEF_TEST(OneOfFrequency, Generator)
+{
+  auto one = gen::OneOf(gen::InRange(0, 9), gen::InRange(100, 109), gen::ElementOf(-1));
+  auto freq = gen::Frequency(gen::Weighted(9, gen::ElementOf(0)),
+                             gen::Weighted(1, gen::ElementOf(1)));
+  size_t counts[3] = {0, 0, 0};
+  size_t ones = 0;
+  for (unsigned long seed = 0; seed < 3000; ++seed)
+  {
+    int i = one.generate(1, seed);
+    counts[i < 0 ? 2 : i < 100 ? 0 : 1]++;
+    ones += static_cast<size_t>(freq.generate(1, seed));
+  }
+  return counts[0] > 800 && counts[1] > 800 && counts[2] > 800
+    && ones > 200 && ones < 400
+    && one.generate(0, 1234) == 0 && freq.generate(0, 1234) == 0;
+}
+
+//------------------------------------------------------------------------------
+struct Point
+{
+  int x;
+  int y;
+};
+
+namespace testinator
+{
+  template <>
+  struct Arbitrary<Point> : public ArbitraryFromGenerator<Arbitrary<Point>>
+  {
+    static auto generator()
+    {
+      return gen::Map(gen::InRange(0, 99), [] (int x) { return Point{x, 99 - x}; });
+    }
+  };
+}
+
+ostream& operator<<(ostream& s, const Point& p)
+{
+  return s << '(' << p.x << ',' << p.y << ')';
+}
+
+DEF_PROPERTY(ArbitraryFromGenerator, Generator, const Point& p)
+{
+  return p.x >= 0 && p.x + p.y == 99;
+}
+
+DEF_TEST(ShrinkChoices, Generator)
+{
+  // a failure shrinks through the choices the generator made
+  struct Small
+  {
+    bool operator()(const Point& p) const { return p.x < 10; }
+    unsigned long m_randomSeed = 1;
+  };
+  ostringstream oss;
+  DefaultOutputter op(oss, OF_NONE);
+  CheckParams params;
+  params.m_shrinkParams.m_useChoices = true;
+  bool failed = !Property(Small{}).check(100, &op, nullptr, params);
+  return failed && oss.str().find("(10,89)") != string::npos;
+}
@@ -0,0 +1,67 @@
+// Copyright (c) 2014-2016 Ben Deane
+// This code is distributed under the MIT license. See LICENSE for details.
+
+// Built with sanitizer coverage and TESTINATOR_COVERAGE (see coverage.h).
+
+#define TESTINATOR_MAIN
+#include <testinator.h>
+
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+// Each character of the failing strings is in a range of 12 (of 95), so random
+// strings fail about once in 8^6 times; but each one is a new branch.
+static bool InRange(char c, char lo)
+{
+  return static_cast<unsigned>(c) - static_cast<unsigned>(lo) < 12u;
+}
+
+struct DeepFunctor
+{
+  bool operator()(const string& s) const
+  {
+    if (s.size() >= 6 && InRange(s[0], 'a'))
+      if (InRange(s[1], 'A'))
+        if (InRange(s[2], '0'))
+          if (InRange(s[3], 'm'))
+            if (InRange(s[4], 'M'))
+              if (InRange(s[5], '!'))
+                return false;
+    return true;
+  }
+  unsigned long m_randomSeed = 1;
+};
+
+static string CheckDeep(bool guided)
+{
+  testinator::Property p(DeepFunctor{});
+  ostringstream oss;
+  testinator::DefaultOutputter op(oss, testinator::OF_NONE);
+  testinator::CheckParams params;
+  params.m_maxSize = 8;
+  params.m_guided = guided;
+  return p.check(40000, &op, nullptr, params) ? string() : oss.str();
+}
+
+DEF_TEST(Instrumented, Guided)
+{
+  return testinator::CoverageMap::Instrumented();
+}
+
+DEF_TEST(FindsDeepCase, Guided)
+{
+  string guided = CheckDeep(true);
+  return CheckDeep(false).empty()
+    && guided.find("--guided") != string::npos;
+}
+
+DEF_TEST(Reproducible, Guided)
+{
+  string first = CheckDeep(true);
+  return !first.empty()
+    && first.substr(first.find("Reproduce"))
+    == CheckDeep(true).substr(first.find("Reproduce"));
+}
@@ -4,10 +4,17 @@
 #include <testinator.h>
 
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <fstream>
 #include <ios>
+#include <iterator>
 #include <memory>
+#include <set>
 #include <sstream>
 #include <string>
+#include <thread>
 
 using namespace std;
 
@@ -205,7 +212,7 @@ public:
     testinator::Results rs = r.RunAllTests(testinator::RunParams(), op.get());
 
     static string expected =
-      "main.cpp:184 (!fail == fail => false == true)";
+      "main.cpp:191 (!fail == fail => false == true)";
     return !rs.empty() && !rs.front().m_success
       && oss.str().find(expected) != string::npos;
   }
@@ -470,7 +477,7 @@ public:
     TestBranchInternal2 myTestA("A");
     testinator::Results rs = testinator::RunAllTests(testinator::RunParams(), op.get());
 
-    static string expected = "main.cpp:448";
+    static string expected = "main.cpp:455";
     return !rs.empty() && rs.front().m_success
       && oss.str().find(expected) != string::npos;
   }
@@ -810,14 +817,721 @@ DEF_TEST(ArbitraryCoverage, Test)
   return v.empty();
 }
 
+//------------------------------------------------------------------------------
+class TestParallelInternal : public testinator::Test
+{
+public:
+  TestParallelInternal(testinator::TestRegistry& r, const string& name, bool fail)
+    : testinator::Test(r, name, "Parallel")
+    , m_fail(fail)
+  {}
+
+  virtual bool Run()
+  {
+    DIAGNOSTIC("diagnostic " << GetName());
+    m_runCalled = true;
+    return !m_fail;
+  }
+
+  bool m_fail;
+  bool m_runCalled = false;
+};
+
+//------------------------------------------------------------------------------
+DEF_TEST(ParallelResults, Test)
+{
+  testinator::TestRegistry r;
+  ostringstream oss;
+  std::unique_ptr<testinator::Outputter> op =
+    make_unique<testinator::DefaultOutputter>(oss);
+
+  static const int NUM_TESTS = 64;
+  vector<unique_ptr<TestParallelInternal>> tests;
+  for (int i = 0; i < NUM_TESTS; ++i)
+  {
+    tests.push_back(make_unique<TestParallelInternal>(
+                        r, "test" + to_string(1000 + i), i % 4 == 0));
+  }
+
+  testinator::RunParams params;
+  params.m_flags = testinator::RF_ALPHA_ORDER;
+  params.m_numJobs = 4;
+  testinator::Results rs = r.RunAllTests(params, op.get());
+
+  bool allRan = all_of(tests.cbegin(), tests.cend(),
+                       [] (const unique_ptr<TestParallelInternal>& t)
+                       { return t->m_runCalled; });
+  bool inOrder = is_sorted(rs.cbegin(), rs.cend(),
+                           [] (const testinator::Result& a,
+                               const testinator::Result& b)
+                           { return a.m_testName < b.m_testName; });
+  auto numPassed = count_if(rs.cbegin(), rs.cend(),
+                            [] (const testinator::Result& res)
+                            { return res.m_success; });
+  return allRan && inOrder
+    && rs.size() == NUM_TESTS
+    && numPassed == NUM_TESTS * 3 / 4
+    && rs.front().m_suiteName == "Parallel";
+}
+
+//------------------------------------------------------------------------------
+DEF_TEST(ParallelTAPOutput, Test)
+{
+  testinator::TestRegistry r;
+  ostringstream oss;
+  std::unique_ptr<testinator::Outputter> op =
+    make_unique<testinator::TAPOutputter>(oss);
+
+  static const int NUM_TESTS = 32;
+  vector<unique_ptr<TestParallelInternal>> tests;
+  for (int i = 0; i < NUM_TESTS; ++i)
+  {
+    tests.push_back(make_unique<TestParallelInternal>(
+                        r, "test" + to_string(i), false));
+  }
+
+  testinator::RunParams params;
+  params.m_numJobs = 4;
+  testinator::Results rs = r.RunAllTests(params, op.get());
+
+  // Each test's diagnostic must immediately precede its result, and results
+  // must be numbered consecutively.
+  istringstream iss(oss.str());
+  string line;
+  getline(iss, line);
+  if (line != "1.." + to_string(NUM_TESTS)) return false;
+  for (int i = 1; i <= NUM_TESTS; ++i)
+  {
+    string diag;
+    string result;
+    getline(iss, diag);
+    getline(iss, result);
+    string name = diag.substr(diag.rfind(' ') + 1);
+    if (result != "ok " + to_string(i) + " " + name) return false;
+  }
+  return rs.size() == NUM_TESTS;
+}
+
+//------------------------------------------------------------------------------
+DEF_TEST(HistoryLongestFirst, Test)
+{
+  static const char* historyFile = "testinator_history_test.txt";
+  {
+    ofstream ofs(historyFile);
+    ofs << "Parallel\ta\t1000000\n"
+        << "Parallel\tb\t5000000\n"
+        << "Parallel\tc\t3000000\n"
+        << "malformed line\n";
+  }
+
+  testinator::TestRegistry r;
+  ostringstream oss;
+  std::unique_ptr<testinator::Outputter> op =
+    make_unique<testinator::DefaultOutputter>(oss);
+  TestParallelInternal a(r, "a", false);
+  TestParallelInternal b(r, "b", false);
+  TestParallelInternal c(r, "c", false);
+  TestParallelInternal d(r, "d", false);
+
+  testinator::RunParams params;
+  params.m_flags = testinator::RF_ALPHA_ORDER;
+  params.m_historyFile = historyFile;
+  testinator::Results rs = r.RunAllTests(params, op.get());
+
+  // d has no history, so it is expected to take the mean time (3ms) and keeps
+  // its alphabetical place after c.
+  bool longestFirst = rs.size() == 4
+    && rs[0].m_testName == "b" && rs[1].m_testName == "c"
+    && rs[2].m_testName == "d" && rs[3].m_testName == "a";
+
+  testinator::DurationHistory h;
+  h.Load(historyFile);
+  remove(historyFile);
+
+  testinator::DurationHistory::Duration dd;
+  static string expected = "Predicted critical path 12ms";
+  return longestFirst
+    && h.Lookup("Parallel", "d", dd)
+    && oss.str().find(expected) != string::npos;
+}
+
+//------------------------------------------------------------------------------
+DEF_TEST(PredictCriticalPath, Test)
+{
+  using D = testinator::DurationHistory::Duration;
+  vector<D> costs = { D(5), D(4), D(3), D(3), D(3) };
+  return testinator::PredictCriticalPath(costs, 1) == D(18)
+    && testinator::PredictCriticalPath(costs, 2) == D(10)
+    && testinator::PredictCriticalPath(costs, 8) == D(5);
+}
+
+//------------------------------------------------------------------------------
+DEF_TEST(ShardsAreDisjoint, Test)
+{
+  testinator::TestRegistry r;
+  testinator::Outputter op;
+  static const int NUM_TESTS = 50;
+  vector<unique_ptr<TestParallelInternal>> tests;
+  for (int i = 0; i < NUM_TESTS; ++i)
+  {
+    tests.push_back(make_unique<TestParallelInternal>(
+                        r, "test" + to_string(i), false));
+  }
+
+  static const size_t NUM_SHARDS = 3;
+  set<string> seen;
+  size_t total = 0;
+  for (size_t i = 0; i < NUM_SHARDS; ++i)
+  {
+    testinator::RunParams params;
+    params.m_shardIndex = i;
+    params.m_shardCount = NUM_SHARDS;
+    testinator::Results rs = r.RunAllTests(params, &op);
+    if (rs.empty()) return false;
+    total += rs.size();
+    for (const auto& res : rs)
+    {
+      seen.insert(res.m_testName);
+    }
+  }
+  return total == NUM_TESTS && seen.size() == NUM_TESTS;
+}
+
+//------------------------------------------------------------------------------
+DEF_TEST(ShardsBalancedByHistory, Test)
+{
+  static const char* historyFile = "testinator_shard_history_test.txt";
+  static const int NUM_TESTS = 8;
+
+  testinator::TestRegistry r;
+  testinator::Outputter op;
+  vector<unique_ptr<TestParallelInternal>> tests;
+  for (int i = 1; i <= NUM_TESTS; ++i)
+  {
+    tests.push_back(make_unique<TestParallelInternal>(
+                        r, "test" + to_string(i), false));
+  }
+
+  // Costs 1..8ms split into two shards of 18ms each. A sharded run reads
+  // the history but doesn't update it, so every shard sees the same file.
+  string history;
+  {
+    ostringstream oss;
+    for (int j = 1; j <= NUM_TESTS; ++j)
+    {
+      oss << "Parallel\ttest" << j << '\t' << j * 1000000 << '\n';
+    }
+    history = oss.str();
+    ofstream(historyFile) << history;
+  }
+  long long shardCost[2] = { 0, 0 };
+  size_t total = 0;
+  for (size_t i = 0; i < 2; ++i)
+  {
+    testinator::RunParams params;
+    params.m_historyFile = historyFile;
+    params.m_shardIndex = i;
+    params.m_shardCount = 2;
+    testinator::Results rs = r.RunAllTests(params, &op);
+    total += rs.size();
+    for (const auto& res : rs)
+    {
+      shardCost[i] += stoll(res.m_testName.substr(4));
+    }
+  }
+  ostringstream after;
+  after << ifstream(historyFile).rdbuf();
+  remove(historyFile);
+  return total == NUM_TESTS && shardCost[0] == 18 && shardCost[1] == 18
+    && after.str() == history;
+}
+
+#ifdef TESTINATOR_ISOLATION_SUPPORTED
+//------------------------------------------------------------------------------
+class TestCrashInternal : public testinator::Test
+{
+public:
+  TestCrashInternal(testinator::TestRegistry& r, const string& name)
+    : testinator::Test(r, name, "Isolate")
+  {}
+
+  virtual bool Run()
+  {
+    DIAGNOSTIC("about to crash");
+    abort();
+  }
+};
+
+//------------------------------------------------------------------------------
+DEF_TEST(IsolateCrash, Test)
+{
+  testinator::TestRegistry r;
+  ostringstream oss;
+  std::unique_ptr<testinator::Outputter> op =
+    make_unique<testinator::TAPOutputter>(oss);
+
+  TestCrashInternal crash1(r, "crash1");
+  TestCrashInternal crash2(r, "crash2");
+  TestCrashInternal crash3(r, "crash3");
+  TestParallelInternal pass1(r, "pass1", false);
+  TestParallelInternal pass2(r, "pass2", false);
+
+  // One worker: it must be replaced after each crash for the run to finish.
+  testinator::RunParams params;
+  params.m_flags = testinator::RF_ALPHA_ORDER | testinator::RF_ISOLATE;
+  testinator::Results rs = r.RunAllTests(params, op.get());
+
+  static string expected1 =
+    "# about to crash\n# crash1: worker process killed by signal";
+  static string expected2 = "not ok 3 crash3";
+  static string expected3 = "ok 5 pass2";
+  return rs.size() == 5
+    && !rs[0].m_success && !rs[1].m_success && !rs[2].m_success
+    && rs[3].m_success && rs[4].m_success
+    && oss.str().find(expected1) != string::npos
+    && oss.str().find(expected2) != string::npos
+    && oss.str().find(expected3) != string::npos;
+}
+
+//------------------------------------------------------------------------------
+// Crashes before it starts.
+class TestCrashInSetupInternal : public testinator::Test
+{
+public:
+  TestCrashInSetupInternal(testinator::TestRegistry& r, const string& name)
+    : testinator::Test(r, name, "Isolate")
+  {}
+
+  virtual bool Setup(const testinator::RunParams&) override
+  {
+    abort();
+  }
+};
+
+// Counts the tests started and ended.
+struct CountingOutputter : public testinator::Outputter
+{
+  virtual void startTest(const std::string&) const override { ++m_started; }
+  virtual void endTest(const std::string&, bool) const override { ++m_ended; }
+
+  mutable int m_started = 0;
+  mutable int m_ended = 0;
+};
+
+//------------------------------------------------------------------------------
+DEF_TEST(IsolateCrashInSetup, Test)
+{
+  testinator::TestRegistry r;
+  CountingOutputter op;
+
+  TestCrashInSetupInternal crash(r, "crash");
+  TestParallelInternal pass(r, "pass", false);
+
+  testinator::RunParams params;
+  params.m_flags = testinator::RF_ALPHA_ORDER | testinator::RF_ISOLATE;
+  testinator::Results rs = r.RunAllTests(params, &op);
+
+  // the crashed test is still reported as started before it ends
+  return rs.size() == 2 && !rs[0].m_success && rs[1].m_success
+    && op.m_started == 2 && op.m_ended == 2;
+}
+
+//------------------------------------------------------------------------------
+DEF_TEST(IsolateAbort, Test)
+{
+  testinator::TestRegistry r;
+  ostringstream oss;
+  std::unique_ptr<testinator::Outputter> op =
+    make_unique<testinator::DefaultOutputter>(oss, testinator::OF_NONE);
+
+  TestAbortInternal myTestA(r, "A");
+  TestAbortInternal myTestB(r, "B");
+  testinator::RunParams params;
+  params.m_flags = testinator::RF_ALPHA_ORDER | testinator::RF_ISOLATE;
+  testinator::Results rs = r.RunAllTests(params, op.get());
+
+  static string expected = "ABORT (Hello world 42)";
+  return rs.size() == 1
+    && oss.str().find(expected) != string::npos;
+}
+#endif
+
+//------------------------------------------------------------------------------
+DEF_TEST(ListTestsJSON, Listing)
+{
+  ostringstream oss;
+  testinator::ListTests(oss, "json", testinator::RunParams());
+  const string& s = oss.str();
+  return s.compare(0, 11, "{\"tests\": [") == 0
+    && s.find("{\"suite\": \"Listing\", \"name\": \"ListTestsJSON\", "
+              "\"type\": \"TEST\", \"cost\": 0}") != string::npos
+    && s.find("{\"suite\": \"Property\", \"name\": \"NumChecksProperty\", "
+              "\"type\": \"PROPERTY\", \"cost\": 0}") != string::npos
+    && s.find("\"type\": \"COMPLEXITY_PROPERTY\"") != string::npos
+    && s.find("\"type\": \"TIMED_TEST\"") != string::npos;
+}
+
+//------------------------------------------------------------------------------
+DEF_TEST(UnregisterCompacts, Registry)
+{
+  testinator::TestRegistry r;
+  std::deque<testinator::Test> tests;
+  for (int i = 0; i < 100; ++i)
+  {
+    tests.emplace_back(r, "T" + std::to_string(i), i % 2 ? "Odd" : "Even");
+  }
+  // unregister most of them, in registration order, forcing compaction
+  for (int i = 0; i < 90; ++i)
+  {
+    tests.pop_front();
+  }
+  testinator::Test late(r, "T90", "Late");
+
+  testinator::RunParams params;
+  params.m_flags = testinator::RF_ALPHA_ORDER;
+  return r.RunAllTests(params).size() == 11
+    && r.RunSuite("Odd", params).size() == 5
+    && r.RunSuite("Even", params).size() == 5
+    && r.RunTest("T90", params).size() == 2
+    && r.RunTest("T0", params).empty();
+}
+
+//------------------------------------------------------------------------------
+DEF_TEST(GlobMatch, Filter)
+{
+  using testinator::GlobMatch;
+  return GlobMatch("*", "")
+    && GlobMatch("*", "abc")
+    && GlobMatch("a?c", "abc")
+    && GlobMatch("a*c", "abbbc")
+    && GlobMatch("*b*", "abc")
+    && GlobMatch("a*b*c", "aXbYbZc")
+    && !GlobMatch("a*c", "abcd")
+    && !GlobMatch("?", "")
+    && !GlobMatch("abc", "ab");
+}
+
+//------------------------------------------------------------------------------
+DEF_TEST(SelectsMatching, Filter)
+{
+  testinator::TestRegistry r;
+  std::deque<testinator::Test> tests;
+  for (int i = 0; i < 30; ++i)
+  {
+    tests.emplace_back(r, "T" + std::to_string(i), i % 2 ? "Odd" : "Even");
+  }
+
+  testinator::RunParams params;
+  params.m_flags = testinator::RF_ALPHA_ORDER;
+  auto names = [&] (const std::string& expr) {
+    std::string ret;
+    for (const auto& res : r.RunFiltered(testinator::TestFilter(expr), params))
+    {
+      ret += res.m_suiteName + '.' + res.m_testName + ' ';
+    }
+    return ret;
+  };
+
+  return names("T1?-T15:T17:T19") == "Even.T10 Odd.T11 Even.T12 Odd.T13 "
+    "Even.T14 Even.T16 Even.T18 "
+    && names("Odd.T2?:Even.T2?:T1") == "Odd.T1 Even.T20 Odd.T21 Even.T22 "
+    "Odd.T23 Even.T24 Odd.T25 Even.T26 Odd.T27 Even.T28 Odd.T29 "
+    && names("Odd.*-*.T1*:*.T2*:*.T?") == ""
+    && names("Ev*.*4") == "Even.T14 Even.T24 Even.T4 "
+    && names("Even.T3") == ""
+    && names("-*") == ""
+    && r.RunFiltered(testinator::TestFilter("-Odd.*"), params).size() == 15
+    && r.RunFiltered(testinator::TestFilter::Exact("Odd", "T7"), params).size() == 1;
+}
+
+//------------------------------------------------------------------------------
+// Fails after a delay (long enough for the others to start, even on a loaded
+// machine), or runs until the run is cancelled (or 10s pass).
+class TestCancelInternal : public testinator::Test
+{
+public:
+  TestCancelInternal(testinator::TestRegistry& r, const string& name, bool fail)
+    : testinator::Test(r, name, "Cancel")
+    , m_fail(fail)
+  {}
+
+  virtual bool Run()
+  {
+    if (m_fail)
+    {
+      this_thread::sleep_for(chrono::milliseconds(250));
+      return false;
+    }
+    auto start = chrono::steady_clock::now();
+    while (chrono::steady_clock::now() - start < chrono::seconds(10))
+    {
+      if (CancellationRequested()) return true;
+      this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    return false;
+  }
+
+  bool m_fail;
+};
+
+namespace
+{
+  bool CheckFailFast(uint32_t flags, std::size_t numJobs)
+  {
+    testinator::TestRegistry r;
+    ostringstream oss;
+    std::unique_ptr<testinator::Outputter> op =
+      make_unique<testinator::TAPOutputter>(oss);
+
+    TestCancelInternal myTestA(r, "A", true);
+    TestCancelInternal myTestB(r, "B", false);
+    TestCancelInternal myTestC(r, "C", false);
+    testinator::RunParams params;
+    params.m_flags = testinator::RF_ALPHA_ORDER | testinator::RF_FAIL_FAST | flags;
+    params.m_numJobs = numJobs;
+    auto start = chrono::steady_clock::now();
+    testinator::Results rs = r.RunAllTests(params, op.get());
+    auto elapsed = chrono::steady_clock::now() - start;
+
+    // A fails, cancelling B in flight; C never starts
+    const string& s = oss.str();
+    return rs.size() == 2
+      && !rs[0].m_success && rs[1].m_success
+      && s.find("not ok 1 A") != string::npos
+      && s.find("Bail out! A failed; cancelling the run") != string::npos
+      && s.find("ok 2 B # skip cancelled") != string::npos
+      && s.find(" C") == string::npos
+      && elapsed < chrono::seconds(5);
+  }
+}
+
+DEF_TEST(FailFastSerial, Cancel)
+{
+  testinator::TestRegistry r;
+  TestCancelInternal myTestA(r, "A", true);
+  TestCancelInternal myTestB(r, "B", true);
+  testinator::RunParams params;
+  params.m_flags = testinator::RF_ALPHA_ORDER | testinator::RF_FAIL_FAST;
+  testinator::Results rs = r.RunAllTests(params);
+  return rs.size() == 1 && rs[0].m_testName == "A";
+}
+
+DEF_TEST(FailFastParallel, Cancel)
+{
+  return CheckFailFast(testinator::RF_NONE, 2);
+}
+
+#ifdef TESTINATOR_ISOLATION_SUPPORTED
+DEF_TEST(FailFastIsolated, Cancel)
+{
+  return CheckFailFast(testinator::RF_ISOLATE, 2);
+}
+#endif
+
+//------------------------------------------------------------------------------
+// Hangs (without polling for cancellation) inside two branches.
+class TestHangInternal : public testinator::Test
+{
+public:
+  TestHangInternal(testinator::TestRegistry& r, const string& name,
+                   std::chrono::milliseconds timeout = std::chrono::milliseconds(0))
+    : testinator::Test(r, name, "Timeout")
+    , m_timeout(timeout)
+  {}
+
+  virtual bool Run()
+  {
+    BRANCH(outer)
+    {
+      BRANCH(inner)
+      {
+        this_thread::sleep_for(chrono::seconds(10));
+      }
+    }
+    return true;
+  }
+
+  virtual std::chrono::milliseconds GetTimeout() const { return m_timeout; }
+
+  std::chrono::milliseconds m_timeout;
+};
+
+#ifdef TESTINATOR_ISOLATION_SUPPORTED
+//------------------------------------------------------------------------------
+DEF_TEST(TimeoutIsolated, Timeout)
+{
+  testinator::TestRegistry r;
+  ostringstream oss;
+  std::unique_ptr<testinator::Outputter> op =
+    make_unique<testinator::DefaultOutputter>(oss, testinator::OF_NONE);
+
+  TestHangInternal myTestA(r, "A");
+  TestParallelInternal myTestB(r, "B", false);
+  testinator::RunParams params;
+  params.m_flags = testinator::RF_ALPHA_ORDER | testinator::RF_ISOLATE;
+  params.m_timeout = chrono::milliseconds(200);
+  auto start = chrono::steady_clock::now();
+  testinator::Results rs = r.RunAllTests(params, op.get());
+  auto elapsed = chrono::steady_clock::now() - start;
+
+  // the worker running A is killed, and a new one runs B
+  return rs.size() == 2
+    && !rs[0].m_success && rs[1].m_success
+    && oss.str().find("ABORT (A timed out after 200ms)") != string::npos
+    && oss.str().find("PASS: B") != string::npos
+    && elapsed < chrono::seconds(5);
+}
+
+//------------------------------------------------------------------------------
+DEF_TEST(TimeoutInProcess, Timeout)
+{
+  static const char* outputFile = "testinator_timeout_test.txt";
+  std::cout.flush();
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    {
+      testinator::TestRegistry r;
+      ofstream ofs(outputFile);
+      std::unique_ptr<testinator::Outputter> op =
+        make_unique<testinator::DefaultOutputter>(ofs, testinator::OF_NONE);
+      TestHangInternal myTestA(r, "A", chrono::milliseconds(100));
+      testinator::RunParams params;
+      params.m_timeout = chrono::seconds(100);
+      r.RunAllTests(params, op.get());
+    }
+    _exit(0);
+  }
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+  ifstream ifs(outputFile);
+  string output((istreambuf_iterator<char>(ifs)), istreambuf_iterator<char>());
+  remove(outputFile);
+
+  // the test's own timeout applies, and the watchdog exits the process
+  return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_FAILURE
+    && output.find("ABORT (A timed out after 100ms)\n"
+                   "  in branch outer\n"
+                   "  in branch inner\n") != string::npos;
+}
+#endif
+
+//------------------------------------------------------------------------------
+// Records the seed of each run; fails on the given run (counting from 1).
+class TestSeedInternal : public testinator::Test
+{
+public:
+  TestSeedInternal(testinator::TestRegistry& r, size_t failOn = 0)
+    : testinator::Test(r, "TestSeedInternal", "TestSeedInternal")
+    , m_failOn(failOn)
+  {}
+
+  virtual bool Setup(const testinator::RunParams& params) override
+  {
+    m_seeds.push_back(params.m_randomSeed);
+    return true;
+  }
+
+  virtual bool Run() override
+  {
+    return m_seeds.size() != m_failOn;
+  }
+
+  size_t m_failOn;
+  vector<unsigned long> m_seeds;
+};
+
+//------------------------------------------------------------------------------
+DEF_TEST(RepeatSeeds, Repeat)
+{
+  testinator::TestRegistry r;
+  ostringstream oss;
+  std::unique_ptr<testinator::Outputter> op =
+    make_unique<testinator::DefaultOutputter>(oss, testinator::OF_NONE);
+
+  TestSeedInternal myTest(r);
+  testinator::RunParams params;
+  params.m_randomSeed = 42;
+  auto run = [&] (const testinator::RunParams& ps, const testinator::Outputter* o) {
+    return r.RunAllTests(ps, o);
+  };
+  testinator::Results rs = testinator::RunRepeatedly(run, params, 5, false, op.get());
+
+  // each repetition gets a distinct derived seed, which is logged
+  bool ok = rs.size() == 5 && myTest.m_seeds.size() == 5;
+  for (size_t i = 0; ok && i < 5; ++i)
+  {
+    auto seed = testinator::DeriveSeed(42, i);
+    ok = myTest.m_seeds[i] == seed && seed != 42
+      && oss.str().find("Repetition " + to_string(i + 1)
+                        + ": reproduce with --seed=" + to_string(seed))
+      != string::npos;
+  }
+  return ok && myTest.m_seeds[0] != myTest.m_seeds[1]
+    && oss.str().find("5/5 tests passed.") != string::npos
+    && oss.str().find("1/1 tests passed.") == string::npos;
+}
+
+//------------------------------------------------------------------------------
+DEF_TEST(RepeatUntilFail, Repeat)
+{
+  testinator::TestRegistry r;
+  ostringstream oss;
+  std::unique_ptr<testinator::Outputter> op =
+    make_unique<testinator::TAPOutputter>(oss);
+
+  TestSeedInternal myTest(r, 3);
+  testinator::RunParams params;
+  auto run = [&] (const testinator::RunParams& ps, const testinator::Outputter* o) {
+    return r.RunAllTests(ps, o);
+  };
+  testinator::Results rs = testinator::RunRepeatedly(run, params, 0, true, op.get());
+
+  // only the failing repetition's results are kept, and the TAP output has
+  // one plan (at the end, since the run's length wasn't known)
+  const string& out = oss.str();
+  return rs.size() == 1 && !rs[0].m_success && myTest.m_seeds.size() == 3
+    && out.find("not ok 3 TestSeedInternal\n1..3\n") != string::npos
+    && out.find("1..") == out.rfind("1..");
+}
+
+//------------------------------------------------------------------------------
+DEF_TEST(RepeatPlan, Repeat)
+{
+  testinator::TestRegistry r;
+  ostringstream oss;
+  std::unique_ptr<testinator::Outputter> op =
+    make_unique<testinator::TAPOutputter>(oss);
+
+  TestSeedInternal myTest(r);
+  testinator::RunParams params;
+  auto run = [&] (const testinator::RunParams& ps, const testinator::Outputter* o) {
+    return r.RunAllTests(ps, o);
+  };
+  testinator::RunRepeatedly(run, params, 4, false, op.get());
+
+  // the plan is given once, up front, for all the repetitions
+  const string& out = oss.str();
+  return out.find("1..4\n") != string::npos
+    && out.find("1..") == out.rfind("1..")
+    && out.find("1..") < out.find("ok 1 ")
+    && out.find("ok 4 TestSeedInternal") != string::npos;
+}
+
 //------------------------------------------------------------------------------
 int main(int argc, char* argv[])
 {
   string outputterName;
   string testName;
   string suiteName;
+  string filter;
   testinator::RunParams p;
   auto oflags = testinator::OF_COLOR|testinator::OF_QUIET_SUCCESS;
+  std::size_t numRepeats = 0;
+  bool untilFail = false;
+  bool listTests = false;
+  string listFormat;
 
   for (int i = 1; i < argc; ++i)
   {
@@ -850,6 +1564,15 @@ int main(int argc, char* argv[])
       }
     }
 
+    {
+      string option = "--filter=";
+      if (s.compare(0, option.size(), option) == 0)
+      {
+        filter = s.substr(option.size());
+        continue;
+      }
+    }
+
     {
       string option = "--numChecks=";
       if (s.compare(0, option.size(), option) == 0)
@@ -870,6 +1593,160 @@ int main(int argc, char* argv[])
       }
     }
 
+    {
+      string option = "--jobs=";
+      if (s.compare(0, option.size(), option) == 0)
+      {
+        char* end;
+        p.m_numJobs = strtoul(s.substr(option.size()).c_str(), &end, 10);
+        continue;
+      }
+    }
+
+    {
+      string option = "--checkThreads=";
+      if (s.compare(0, option.size(), option) == 0)
+      {
+        char* end;
+        p.m_numCheckThreads = strtoul(s.substr(option.size()).c_str(), &end, 10);
+        continue;
+      }
+    }
+
+    {
+      string option = "--shrinkSteps=";
+      if (s.compare(0, option.size(), option) == 0)
+      {
+        char* end;
+        p.m_shrinkParams.m_maxSteps = strtoul(s.substr(option.size()).c_str(), &end, 10);
+        continue;
+      }
+    }
+
+    {
+      string option = "--shrinkTime=";
+      if (s.compare(0, option.size(), option) == 0)
+      {
+        char* end;
+        p.m_shrinkParams.m_maxTime = std::chrono::milliseconds(
+            strtoul(s.substr(option.size()).c_str(), &end, 10));
+        continue;
+      }
+    }
+
+    {
+      string option = "--maxSize=";
+      if (s.compare(0, option.size(), option) == 0)
+      {
+        char* end;
+        p.m_maxSize = strtoul(s.substr(option.size()).c_str(), &end, 10);
+        continue;
+      }
+    }
+
+    {
+      string option = "--shrinkChoices";
+      if (s.compare(0, option.size(), option) == 0)
+      {
+        p.m_shrinkParams.m_useChoices = true;
+        continue;
+      }
+    }
+
+    {
+      string option = "--guided";
+      if (s.compare(0, option.size(), option) == 0)
+      {
+        p.m_guided = true;
+        continue;
+      }
+    }
+
+    {
+      string option = "--arena";
+      if (s.compare(0, option.size(), option) == 0)
+      {
+        p.m_arena = true;
+        continue;
+      }
+    }
+
+    {
+      string option = "--examples=";
+      if (s.compare(0, option.size(), option) == 0)
+      {
+        p.m_exampleDirectory = s.substr(option.size());
+        continue;
+      }
+    }
+
+    {
+      string option = "--history=";
+      if (s.compare(0, option.size(), option) == 0)
+      {
+        p.m_historyFile = s.substr(option.size());
+        continue;
+      }
+    }
+
+    {
+      string option = "--shard=";
+      if (s.compare(0, option.size(), option) == 0)
+      {
+        char* end;
+        p.m_shardIndex = strtoul(s.substr(option.size()).c_str(), &end, 10);
+        if (*end == '/')
+          p.m_shardCount = strtoul(end + 1, &end, 10);
+        if (*end != 0 || p.m_shardCount == 0 || p.m_shardIndex >= p.m_shardCount)
+        {
+          std::cerr << "Invalid shard: " << s << std::endl;
+          return 1;
+        }
+        continue;
+      }
+    }
+
+    {
+      string option = "--timeout=";
+      if (s.compare(0, option.size(), option) == 0)
+      {
+        char* end;
+        p.m_timeout = std::chrono::milliseconds(
+            strtoul(s.substr(option.size()).c_str(), &end, 10));
+        continue;
+      }
+    }
+
+    {
+      string option = "--repeat=";
+      if (s.compare(0, option.size(), option) == 0)
+      {
+        char* end;
+        numRepeats = strtoul(s.substr(option.size()).c_str(), &end, 10);
+        continue;
+      }
+    }
+
+    {
+      string option = "--until-fail";
+      if (s.compare(0, option.size(), option) == 0)
+      {
+        untilFail = true;
+        continue;
+      }
+    }
+
+    {
+      string option = "--list-tests";
+      if (s.compare(0, option.size(), option) == 0)
+      {
+        listTests = true;
+        if (s.size() > option.size() && s[option.size()] == '=')
+          listFormat = s.substr(option.size() + 1);
+        continue;
+      }
+    }
+
     {
       string option = "--alpha";
       if (s.compare(0, option.size(), option) == 0)
@@ -879,6 +1756,24 @@ int main(int argc, char* argv[])
       }
     }
 
+    {
+      string option = "--isolate";
+      if (s.compare(0, option.size(), option) == 0)
+      {
+        p.m_flags |= testinator::RF_ISOLATE;
+        continue;
+      }
+    }
+
+    {
+      string option = "--fail-fast";
+      if (s.compare(0, option.size(), option) == 0)
+      {
+        p.m_flags |= testinator::RF_FAIL_FAST;
+        continue;
+      }
+    }
+
     {
       string option = "--verbose";
       if (s.compare(0, option.size(), option) == 0)
@@ -908,13 +1803,41 @@ int main(int argc, char* argv[])
                   << std::endl
                   << "--testName=NAME    run only the named test" << std::endl
                   << "--suiteName=NAME   run only the tests in the named suite" << std::endl
+                  << "--filter=PATTERNS  run only tests matching PATTERNS, e.g. Suite.*:*Foo*-*Slow"
+                  << std::endl
                   << "--alpha            run tests in alphabetical order" << std::endl
                   << "--output=FORMAT    use the specified output formatter, e.g. TAP" << std::endl
                   << "--verbose          give verbose output (according to formatter)" << std::endl
                   << "--nocolor          output without ANSI color codes (according to formatter)"
                   << std::endl
                   << "--numChecks=N      number of checks to use for property tests" << std::endl
-                  << "--seed=SEED        use SEED for property test randomization" << std::endl;
+                  << "--checkThreads=N   spread property checks over N threads (0 for one per core)"
+                  << std::endl
+                  << "--maxSize=N        generate containers of up to N elements (default 100)"
+                  << std::endl
+                  << "--seed=SEED        use SEED for property test randomization" << std::endl
+                  << "--shrinkSteps=N    shrink a failing value at most N steps (default 1000)"
+                  << std::endl
+                  << "--shrinkTime=MS    spend at most MS shrinking a failing value" << std::endl
+                  << "--shrinkChoices    shrink the random choices behind a failing value"
+                  << std::endl
+                  << "--guided           guide property checks by coverage (see coverage.h)"
+                  << std::endl
+                  << "--arena            allocate pmr property arguments from a per-check arena"
+                  << std::endl
+                  << "--examples=DIR     store failing property examples in DIR; replay them first"
+                  << std::endl
+                  << "--jobs=N           run tests on N threads (0 for one per core)" << std::endl
+                  << "--history=FILE     record test durations in FILE; run longest first" << std::endl
+                  << "--shard=I/N        run only shard I (from 0) of N disjoint shards" << std::endl
+                  << "--isolate          run tests in worker processes (--jobs of them)" << std::endl
+                  << "--fail-fast        stop all tests at the first failure" << std::endl
+                  << "--timeout=MS       fail (and stop) any test that runs longer than MS" << std::endl
+                  << "--repeat=N         run the tests N times, each with its own seed" << std::endl
+                  << "--until-fail       repeat the tests until they fail (at most --repeat times)"
+                  << std::endl
+                  << "--list-tests[=json] list the registered tests instead of running them"
+                  << std::endl;
         return 0;
       }
     }
@@ -939,17 +1862,37 @@ int main(int argc, char* argv[])
   TestTAPAbort test15("TestTAPAbort");
   TestNoSuchTest test16("TestNoSuchTest");
   TestSkipOnSetupFail test17("TestSkipOnSetupFail");
+
+  if (listTests)
+  {
+    testinator::ListTests(std::cout, listFormat, p);
+    return 0;
+  }
+
   testinator::Results rs;
 
   std::unique_ptr<testinator::Outputter> op = testinator::MakeOutputter(
       outputterName, static_cast<testinator::OutputFlags>(oflags));
 
-  if (!testName.empty())
-    rs = testinator::RunTest(testName, p, op.get());
-  else if (!suiteName.empty())
-    rs = testinator::RunSuite(suiteName, p, op.get());
+  auto run = [&] (const testinator::RunParams& params,
+                  const testinator::Outputter* o) {
+    if (!filter.empty())
+      return testinator::RunFiltered(testinator::TestFilter(filter), params, o);
+    else if (!testName.empty() && !suiteName.empty())
+      return testinator::RunFiltered(
+          testinator::TestFilter::Exact(suiteName, testName), params, o);
+    else if (!testName.empty())
+      return testinator::RunTest(testName, params, o);
+    else if (!suiteName.empty())
+      return testinator::RunSuite(suiteName, params, o);
+    else
+      return testinator::RunAllTests(params, o);
+  };
+
+  if (numRepeats > 1 || untilFail)
+    rs = testinator::RunRepeatedly(run, p, numRepeats, untilFail, op.get());
   else
-    rs = testinator::RunAllTests(p, op.get());
+    rs = run(p, op.get());
 
   auto numPassed = count_if(rs.begin(), rs.end(),
                             [] (const testinator::Result& r) { return r.m_success; });
@@ -0,0 +1,122 @@
+// Copyright (c) 2014-2016 Ben Deane
+// This code is distributed under the MIT license. See LICENSE for details.
+
+// Built with C++17, for the pmr containers (see arbitrary_pmr.h).
+
+#define TESTINATOR_MAIN
+#include <testinator.h>
+
+#include <cstddef>
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+// A resource that counts its allocations.
+class CountingResource : public pmr::memory_resource
+{
+public:
+  size_t m_allocations = 0;
+
+private:
+  void* do_allocate(size_t bytes, size_t alignment) override
+  {
+    ++m_allocations;
+    return pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override
+  {
+    pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(const pmr::memory_resource& other) const noexcept override
+  {
+    return this == &other;
+  }
+};
+
+//------------------------------------------------------------------------------
+DEF_TEST(FromGenerationResource, Pmr)
+{
+  CountingResource counter;
+  auto generate = [&] () {
+    testinator::GenerationResource::Scope scope(&counter);
+    return testinator::Arbitrary<pmr::vector<pmr::string>>::generate(7, 1234);
+  };
+  // (initialized, not assigned: assignment would keep the default resource)
+  pmr::vector<pmr::string> v = generate();
+  bool elements = true;
+  for (const auto& s : v)
+  {
+    elements = elements && s.get_allocator().resource() == &counter;
+  }
+  return v.get_allocator().resource() == &counter && elements
+    && counter.m_allocations > 0
+    && testinator::GenerationResource::Current() == pmr::get_default_resource();
+}
+
+DEF_TEST(SameValues, Pmr)
+{
+  // the allocator doesn't change what is generated
+  auto v = testinator::Arbitrary<vector<int>>::generate(7, 1234);
+  auto pv = testinator::Arbitrary<pmr::vector<int>>::generate(7, 1234);
+  auto m = testinator::Arbitrary<map<int, string>>::generate(7, 1234);
+  auto pm = testinator::Arbitrary<pmr::map<int, pmr::string>>::generate(7, 1234);
+  auto n = testinator::Arbitrary<pmr::vector<long>>::generate_n(100, 1234);
+  bool sameMap = m.size() == pm.size();
+  auto j = pm.cbegin();
+  for (auto i = m.cbegin(); sameMap && i != m.cend(); ++i, ++j)
+  {
+    sameMap = i->first == j->first && i->second == j->second.c_str();
+  }
+  return equal(v.cbegin(), v.cend(), pv.cbegin(), pv.cend()) && sameMap
+    && n.size() == 100;
+}
+
+//------------------------------------------------------------------------------
+struct ArenaFunctor
+{
+  bool operator()(const pmr::vector<pmr::string>& v) const
+  {
+    bool arena = v.get_allocator().resource() != pmr::get_default_resource();
+    return arena == m_expectArena;
+  }
+  unsigned long m_randomSeed = 1;
+  bool m_expectArena;
+};
+
+DEF_TEST(Arena, Pmr)
+{
+  testinator::Outputter op;
+  testinator::CheckParams params;
+  params.m_numThreads = 2;
+
+  ArenaFunctor f;
+  f.m_expectArena = false;
+  bool plain = testinator::Property(f).check(100, &op, nullptr, params);
+
+  params.m_arena = true;
+  f.m_expectArena = true;
+  bool arena = testinator::Property(f).check(100, &op, nullptr, params);
+  return plain && arena;
+}
+
+DEF_TEST(ArenaFailure, Pmr)
+{
+  // a failure found in the arena is shrunk and reported as usual
+  struct Short
+  {
+    bool operator()(const pmr::vector<pmr::string>& v) const { return v.size() < 3; }
+    unsigned long m_randomSeed = 1;
+  };
+  ostringstream oss;
+  testinator::DefaultOutputter op(oss, testinator::OF_NONE);
+  testinator::CheckParams params;
+  params.m_arena = true;
+  return !testinator::Property(Short{}).check(100, &op, nullptr, params)
+    && oss.str().find("Reproduce failure") != string::npos;
+}
@@ -1,8 +1,15 @@
 // Copyright (c) 2014-2016 Ben Deane
 // This code is distributed under the MIT license. See LICENSE for details.
 
+#include <fuzz.h>
 #include <property.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
 using namespace std;
 
 //------------------------------------------------------------------------------
@@ -22,6 +29,381 @@ DEF_TEST(Functor, Property)
   return p.check(0, &op);
 }
 
+//------------------------------------------------------------------------------
+struct CountingFunctor
+{
+  bool operator()(int) { ++*m_count; return true; }
+  unsigned long m_randomSeed = 0;
+  int* m_count;
+};
+
+DEF_TEST(Cancelled, Property)
+{
+  int count = 0;
+  CountingFunctor f;
+  f.m_count = &count;
+  testinator::Property p(f);
+  testinator::Outputter op;
+  testinator::CancellationToken token;
+  bool uncancelled = p.check(10, &op, &token) && count == 10;
+  token.Cancel();
+  return uncancelled && p.check(10, &op, &token) && count == 10;
+}
+
+//------------------------------------------------------------------------------
+struct SmallCharFunctor
+{
+  bool operator()(unsigned char c) const { return c < 100 || c > 110; }
+  unsigned long m_randomSeed = 1234;
+};
+
+DEF_TEST(ThreadsSameFailure, Property)
+{
+  // the same check fails, with the same output, whatever the thread count
+  SmallCharFunctor f;
+  testinator::Property p(f);
+  ostringstream serial;
+  testinator::DefaultOutputter serialOp(serial, testinator::OF_NONE);
+  bool serialResult = p.check(1000, &serialOp);
+
+  ostringstream parallel;
+  testinator::DefaultOutputter parallelOp(parallel, testinator::OF_NONE);
+  testinator::CheckParams params;
+  params.m_numThreads = 4;
+  bool parallelResult = p.check(1000, &parallelOp, nullptr, params);
+
+  return !serialResult && !parallelResult
+    && serial.str() == parallel.str()
+    && serial.str().find("Reproduce failure (check ") != string::npos;
+}
+
+//------------------------------------------------------------------------------
+struct AtomicCountingFunctor
+{
+  bool operator()(int) { ++*m_count; return true; }
+  unsigned long m_randomSeed = 0;
+  atomic<int>* m_count;
+};
+
+DEF_TEST(ThreadsAllChecks, Property)
+{
+  // with no failure, every check runs exactly once
+  atomic<int> count{0};
+  AtomicCountingFunctor f;
+  f.m_count = &count;
+  testinator::Property p(f);
+  testinator::Outputter op;
+  testinator::CheckParams params;
+  params.m_numThreads = 3;
+  return p.check(1000, &op, nullptr, params) && count == 1000;
+}
+
+//------------------------------------------------------------------------------
+struct NonEmptyVectorFunctor
+{
+  bool operator()(const vector<int>& v) const { return v.empty(); }
+  unsigned long m_randomSeed = 0;
+};
+
+DEF_TEST(ShrinkGreedy, Property)
+{
+  // the vector halves twice, to 1 element; only the final value is reported
+  NonEmptyVectorFunctor f;
+  testinator::Property p(f);
+  ostringstream oss;
+  testinator::DefaultOutputter op(oss, testinator::OF_NONE);
+  testinator::CheckParams params;
+  params.m_maxSize = 50;
+  bool result = p.check(10, &op, nullptr, params);
+
+  const string& out = oss.str();
+  return !result
+    && out.find("Failed ") == out.rfind("Failed ")
+    && out.find("Shrank in 2 steps (3 evaluations, ") != string::npos
+    && out.find("limit") == string::npos;
+}
+
+DEF_TEST(ShrinkBudget, Property)
+{
+  NonEmptyVectorFunctor f;
+  testinator::Property p(f);
+  ostringstream oss;
+  testinator::DefaultOutputter op(oss, testinator::OF_NONE);
+  testinator::CheckParams params;
+  params.m_shrinkParams.m_maxSteps = 1;
+  bool result = p.check(10, &op, nullptr, params);
+
+  return !result
+    && oss.str().find("Shrank in 1 steps (1 evaluations, ") != string::npos
+    && oss.str().find("; stopped at the step limit") != string::npos;
+}
+
+//------------------------------------------------------------------------------
+struct RecordSizesFunctor
+{
+  bool operator()(const vector<int>& v, const string& s) const
+  {
+    m_sizes->push_back(max(v.size(), s.size()));
+    return true;
+  }
+  unsigned long m_randomSeed = 1;
+  vector<size_t>* m_sizes;
+};
+
+DEF_TEST(SizeRamp, Property)
+{
+  // sizes ramp up from 0 to maxSize over the checks
+  vector<size_t> sizes;
+  RecordSizesFunctor f;
+  f.m_sizes = &sizes;
+  testinator::Property p(f);
+  ostringstream oss;
+  testinator::DefaultOutputter op(oss, testinator::OF_NONE);
+  testinator::CheckParams params;
+  params.m_maxSize = 20;
+  bool result = p.check(100, &op, nullptr, params);
+
+  auto half = sizes.cbegin() + 50;
+  return result && sizes.size() == 100 && sizes[0] == 0
+    && all_of(sizes.cbegin(), half, [] (size_t n) { return n <= 10; })
+    && all_of(half, sizes.cend(), [] (size_t n) { return n <= 20; })
+    && any_of(half, sizes.cend(), [] (size_t n) { return n > 10; });
+}
+
+//------------------------------------------------------------------------------
+struct RecordIntsFunctor
+{
+  bool operator()(int x) const
+  {
+    m_seen->push_back(x);
+    return x <= m_limit;
+  }
+  unsigned long m_randomSeed = 1;
+  int m_limit;
+  vector<int>* m_seen;
+};
+
+DEF_TEST(ExampleDatabase, Property)
+{
+  const string file = testinator::ExampleFile(".", "Property", "ExampleDatabaseTest");
+  testinator::CheckParams params;
+  params.m_shrinkParams.m_useChoices = true;
+  params.m_examplesFile = file;
+
+  // a failure is stored, shrunk
+  vector<int> seen;
+  RecordIntsFunctor f;
+  f.m_limit = 1000;
+  f.m_seen = &seen;
+  {
+    testinator::Property p(f);
+    ostringstream oss;
+    testinator::DefaultOutputter op(oss, testinator::OF_NONE);
+    p.check(100, &op, nullptr, params);
+  }
+  vector<testinator::Example> stored = testinator::LoadExamples(file);
+  bool saved = stored.size() == 1;
+
+  // next time it is the first case checked, whatever the seed
+  seen.clear();
+  f.m_randomSeed = 2;
+  bool replayed;
+  {
+    testinator::Property p(f);
+    ostringstream oss;
+    testinator::DefaultOutputter op(oss, testinator::OF_NONE);
+    replayed = !p.check(100, &op, nullptr, params)
+      && !seen.empty() && seen[0] == 1001
+      && oss.str().find("Stored example") != string::npos;
+  }
+
+  // a cancelled run keeps it, replayed or not
+  f.m_limit = 2000;
+  bool kept;
+  {
+    testinator::Property p(f);
+    testinator::Outputter op;
+    testinator::CancellationToken token;
+    token.Cancel();
+    kept = p.check(100, &op, &token, params)
+      && testinator::LoadExamples(file).size() == 1;
+    testinator::CancellationToken::Interrupted() = false;
+  }
+
+  // once it passes, it is dropped
+  bool dropped;
+  {
+    testinator::Property p(f);
+    ostringstream oss;
+    testinator::DefaultOutputter op(oss, testinator::OF_NONE);
+    dropped = p.check(1, &op, nullptr, params)
+      && !ifstream(file);
+  }
+  remove(file.c_str());
+  return saved && replayed && kept && dropped;
+}
+
+//------------------------------------------------------------------------------
+DEF_TEST(ExampleDescription, Property)
+{
+  const string file = testinator::ExampleFile(".", "Property", "ExampleDescriptionTest");
+  testinator::CheckParams params;
+  params.m_examplesFile = file;
+
+  // without choices shrinking, the unshrunk failure is stored, and described
+  vector<int> seen;
+  RecordIntsFunctor f;
+  f.m_limit = 1000;
+  f.m_seen = &seen;
+  {
+    testinator::Property p(f);
+    testinator::Outputter op;
+    p.check(100, &op, nullptr, params);
+  }
+  string description;
+  getline(ifstream(file), description);
+
+  // as it replays
+  seen.clear();
+  {
+    testinator::Property p(f);
+    testinator::Outputter op;
+    p.check(100, &op, nullptr, params);
+  }
+  remove(file.c_str());
+  return !seen.empty() && seen[0] > 1001
+    && description == "# (" + to_string(seen[0]) + ")";
+}
+
+//------------------------------------------------------------------------------
+// A type whose shrink offers each candidate twice
+struct Halving
+{
+  int m_n;
+};
+
+ostream& operator<<(ostream& s, const Halving& h)
+{
+  return s << h.m_n;
+}
+
+namespace testinator
+{
+  template <>
+  struct Arbitrary<Halving>
+  {
+    static Halving generate(std::size_t, unsigned long int) { return Halving{100}; }
+    static vector<Halving> shrink(const Halving& h)
+    {
+      return { Halving{h.m_n / 2}, Halving{h.m_n / 2} };
+    }
+  };
+}
+
+struct HalvingFunctor
+{
+  bool operator()(const Halving& h) const
+  {
+    ++*m_calls;
+    return h.m_n <= 10;
+  }
+  unsigned long m_randomSeed = 0;
+  int* m_calls;
+};
+
+DEF_TEST(ShrinkNoRepeats, Property)
+{
+  // 100 -> 50 -> 25 -> 12, then 6 passes once and is not tried again
+  int calls = 0;
+  HalvingFunctor f;
+  f.m_calls = &calls;
+  testinator::Property p(f);
+  ostringstream oss;
+  testinator::DefaultOutputter op(oss, testinator::OF_NONE);
+  bool result = p.check(1, &op);
+
+  return !result && calls == 5
+    && oss.str().find("Failed (12)") != string::npos
+    && oss.str().find("(4 evaluations, 1 repeats skipped, ") != string::npos;
+}
+
+DEF_TEST(SeenSet, Property)
+{
+  struct Opaque {};
+  testinator::SeenSet seen;
+  return seen.Insert(1) && !seen.Insert(1) && seen.Insert(2)
+    && seen.Insert(vector<int>{1, 2}) && !seen.Insert(vector<int>{1, 2})
+    && seen.Insert(vector<int>{2, 1})
+    && seen.Insert(make_tuple(string("a"), vector<int>{}))
+    && !seen.Insert(make_tuple(string("a"), vector<int>{}))
+    && seen.Insert(Opaque{}) && seen.Insert(Opaque{});
+}
+
+//------------------------------------------------------------------------------
+struct IntAtMost1000Functor
+{
+  bool operator()(int x) const { return x <= 1000; }
+  unsigned long m_randomSeed = 1;
+};
+
+DEF_TEST(ShrinkChoicesInt, Property)
+{
+  // ints have no shrink, but their choices do
+  testinator::Property p(IntAtMost1000Functor{});
+  ostringstream oss;
+  testinator::DefaultOutputter op(oss, testinator::OF_NONE);
+  testinator::CheckParams params;
+  params.m_shrinkParams.m_useChoices = true;
+  return !p.check(100, &op, nullptr, params)
+    && oss.str().find("Failed (1001)") != string::npos;
+}
+
+//------------------------------------------------------------------------------
+struct SmallElementsFunctor
+{
+  bool operator()(const vector<int>& v) const
+  {
+    return none_of(v.cbegin(), v.cend(), [] (int i) { return i > 100; });
+  }
+  unsigned long m_randomSeed = 1;
+};
+
+DEF_TEST(ShrinkChoicesVector, Property)
+{
+  testinator::Property p(SmallElementsFunctor{});
+  ostringstream oss;
+  testinator::DefaultOutputter op(oss, testinator::OF_NONE);
+  testinator::CheckParams params;
+  params.m_shrinkParams.m_useChoices = true;
+  return !p.check(100, &op, nullptr, params)
+    && oss.str().find("Failed ([101])") != string::npos;
+}
+
+DEF_TEST(CheckBytes, Property)
+{
+  // bytes are varint choices: go on, 202 (i.e. 101), stop
+  SmallElementsFunctor f;
+  const uint8_t failing[] = { 1, 0xca, 0x01, 0 };
+  const uint8_t passing[] = { 1, 0x08, 0 };
+  ostringstream oss;
+  return !testinator::CheckBytes(f, failing, sizeof(failing), 100, &oss)
+    && oss.str() == "([101])"
+    && testinator::CheckBytes(f, passing, sizeof(passing))
+    && testinator::CheckBytes(f, nullptr, 0);
+}
+
+DEF_TEST(FuzzTarget, Property)
+{
+  // a fuzzer runs a registered property in place
+  testinator::PropertyTest* p = testinator::FuzzTarget("StringReverseProperty");
+  const uint8_t abc[] = { 1, 65, 1, 66, 1, 67, 0 };
+  return p != nullptr && p->GetSuiteName() == "Property"
+    && p->CheckBytes(abc, sizeof(abc))
+    && testinator::FuzzTarget(nullptr) == nullptr
+    && testinator::FuzzTarget("NoSuchProperty") == nullptr
+    && testinator::FuzzTarget("O_NComplexityProperty") == nullptr;
+}
+
 //------------------------------------------------------------------------------
 // Another machinery test
 
@@ -248,6 +630,50 @@ DEF_TEST(FailTriggersShrinkPair, Property)
   return !rs.empty() && !rs.front().m_success;
 }
 
+//------------------------------------------------------------------------------
+// EXPECTs that its argument is small (which it isn't, eventually), but always
+// returns true.
+class ExpectSmallInternal : public testinator::PropertyTest
+{
+public:
+  ExpectSmallInternal(testinator::TestRegistry& r, const string& name)
+    : testinator::PropertyTest(r, name, "Property")
+  {}
+
+  virtual bool Run() override
+  {
+    return CheckProperty(*this);
+  }
+
+  bool operator()(const vector<int>& v)
+  {
+    EXPECT(v.size() < 50u);
+    return true;
+  }
+};
+
+DEF_TEST(PropertyExpect, Property)
+{
+  testinator::TestRegistry r;
+  ostringstream oss;
+  testinator::DefaultOutputter op(oss, testinator::OF_NONE);
+  ExpectSmallInternal myTest(r, "A");
+
+  // on one thread, a failed EXPECT in the property fails the test
+  testinator::RunParams p;
+  testinator::Results rs = r.RunAllTests(p, &op);
+  bool serial = rs.size() == 1 && !rs[0].m_success
+    && oss.str().find("EXPECT FAILED") != string::npos;
+
+  // on more than one, the property may not EXPECT at all
+  oss.str("");
+  p.m_numCheckThreads = 2;
+  rs = r.RunAllTests(p, &op);
+  return serial && rs.size() == 1 && !rs[0].m_success
+    && oss.str().find("EXPECT FAILED") != string::npos
+    && oss.str().find("must not write output") != string::npos;
+}
+
 //------------------------------------------------------------------------------
 // A user-defined type test
 